@@ -5,6 +5,8 @@
 #include <midi_sender.h>
 #include <filesystem.h>
 
+#include <algorithm>
+
 #define _log(...) 
 #define _logln(...) 
 
@@ -17,6 +19,152 @@ static Config sConfig = {};
 static Program sPrograms[Program::kMaxPrograms] = {};
 #endif
 
+// Programs and setlists are stored in a compact encoding: strings and arrays
+// carry their length and unused footswitches are left out, so a typical
+// program takes a fraction of sizeof(Program). Files start with kCompactTag
+// and the body size. Files written by earlier firmware hold the raw struct,
+// whose first byte is the name -- empty or printable, never kCompactTag -- and
+// are still loaded; they are rewritten compact on their next save.
+static constexpr uint8_t kCompactTag = 0x01;
+static constexpr size_t kCompactHeaderSize = 3;
+static constexpr size_t kMaxCompactSize = 508;
+// Covers the name, and a setlist's program count, in either format
+static constexpr size_t kNameHeaderSize = kCompactHeaderSize + Program::kMaxNameLength + 2;
+
+class CompactWriter
+{
+public:
+    CompactWriter(uint8_t* buffer, size_t size) : _buffer(buffer), _size(size) {}
+
+    void put(uint8_t value) { put(&value, sizeof(value)); }
+    void put(const void* src, size_t size)
+    {
+        if (_offset + size > _size)
+        {
+            _overflow = true;
+            return;
+        }
+        memcpy(_buffer + _offset, src, size);
+        _offset += size;
+    }
+    void putString(const char* str, size_t max_length)
+    {
+        uint8_t length = strnlen(str, max_length);
+        put(length);
+        put(str, length);
+    }
+    size_t size() const { return _overflow ? 0 : _offset; }
+
+private:
+    uint8_t* _buffer;
+    size_t _size;
+    size_t _offset = 0;
+    bool _overflow = false;
+};
+
+class CompactReader
+{
+public:
+    CompactReader(const uint8_t* buffer, size_t size) : _buffer(buffer), _size(size) {}
+
+    bool get(uint8_t& value) { return get(&value, sizeof(value)); }
+    bool get(void* dst, size_t size)
+    {
+        if (_offset + size > _size)
+        {
+            return false;
+        }
+        memcpy(dst, _buffer + _offset, size);
+        _offset += size;
+        return true;
+    }
+    // `str` must hold max_length + 1 bytes; it is always left terminated
+    bool getString(char* str, size_t max_length)
+    {
+        uint8_t length = 0;
+        bool ok = get(length) && length <= max_length && get(str, length);
+        memset(str + (ok ? length : 0), 0, max_length + 1 - (ok ? length : 0));
+        return ok;
+    }
+
+private:
+    const uint8_t* _buffer;
+    size_t _size;
+    size_t _offset = 0;
+};
+
+// Writes `writer`'s body, encoded at buffer + kCompactHeaderSize, framed by its
+// header. Returns the number of bytes written.
+static size_t writeCompact(File& file, uint8_t* buffer, const CompactWriter& writer)
+{
+    const size_t body_size = writer.size();
+    if (body_size == 0)
+    {
+        return 0;
+    }
+
+    buffer[0] = kCompactTag;
+    buffer[1] = body_size & 0xFF;
+    buffer[2] = body_size >> 8;
+    const size_t size = kCompactHeaderSize + body_size;
+    return (file.write(buffer, size) == size) ? size : 0;
+}
+
+// Reads a stored program or setlist. A compact file leaves its body in
+// `buffer` and returns its size; a legacy one is read straight into `legacy`
+// and returns 0. Returns -1 for unreadable files.
+static int readCompact(File& file, uint8_t* buffer, void* legacy, size_t legacy_size)
+{
+    uint8_t header[kCompactHeaderSize];
+    if (file.read(header, sizeof(header)) != sizeof(header))
+    {
+        return -1;
+    }
+
+    if (header[0] != kCompactTag)
+    {
+        uint8_t* dst = static_cast<uint8_t*>(legacy);
+        memcpy(dst, header, sizeof(header));
+        const size_t rest = legacy_size - sizeof(header);
+        return (file.read(dst + sizeof(header), rest) == rest) ? 0 : -1;
+    }
+
+    const size_t body_size = header[1] | (header[2] << 8);
+    if (body_size == 0 || body_size > kMaxCompactSize || file.read(buffer, body_size) != body_size)
+    {
+        return -1;
+    }
+    return int(body_size);
+}
+
+// Every program and setlist name, and each setlist's program count, mirrored
+// in RAM (about 4 KB) so the menus and the editor's name listings never open a
+// file. Storage::init fills it and every save and remove keeps it current;
+// until it is loaded, copyName reads the files.
+static struct
+{
+    char programs[Program::kMaxPrograms][Program::kMaxNameLength + 1];
+    char setlists[Setlist::kMaxSetlists][Program::kMaxNameLength + 1];
+    uint8_t setlist_sizes[Setlist::kMaxSetlists];
+    bool loaded;
+} sNames = {};
+
+// Points `name` at the name inside a header read by readName, and returns the
+// offset just past it
+static size_t findName(const uint8_t* header, const char*& name, uint8_t& length)
+{
+    if (header[0] != kCompactTag)
+    {
+        name = reinterpret_cast<const char*>(header);
+        length = strnlen(name, Program::kMaxNameLength);
+        return Program::kMaxNameLength + 1;
+    }
+
+    name = reinterpret_cast<const char*>(header + kCompactHeaderSize + 1);
+    length = std::min<uint8_t>(header[kCompactHeaderSize], Program::kMaxNameLength);
+    return kCompactHeaderSize + 1 + length;
+}
+
 void Storage::init()
 {
 #if !FAKE_CONFIG
@@ -28,6 +176,9 @@ void Storage::init()
     {
         Program::initAll();
     }
+    Program::loadNames();
+    Setlist::loadNames();
+    sNames.loaded = true;
 
     auto end = millis();
     printf("Storage init in ms: %u\n", end - start);
@@ -42,6 +193,13 @@ void Storage::init()
         (uint32_t)sizeof(Actions::Action));
 }
 
+void Storage::run()
+{
+#if !FAKE_CONFIG
+    TocataFS.run();
+#endif
+}
+
 void Storage::factoryReset()
 {
     printf("Factory reset: erasing config, all programs and all setlists\n");
@@ -139,30 +297,30 @@ void Config::migrate(size_t bytes_read)
     _expression = {};
 }
 
-void Config::save() const
+bool Config::save() const
 {
 #if FAKE_CONFIG
     memcpy(&sConfig, this, sizeof(Config));
-    return;
+    return true;
 #endif
 
     if (!available())
     {
-        return;
+        return true;
     }
 
     Config current{};
     current.load();
     if (current == *this)
     {
-        return;
+        return true;
     }
 
     File file = TocataFS.open(kPath, FILE_WRITE);
     if (!file)
     {
         _logln(F("Cannot open config file to write"));
-        return;
+        return false;
     }
 
     size_t written = file.write((uint8_t*)this, sizeof(*this));
@@ -172,7 +330,9 @@ void Config::save() const
     {
         _logln(F("Cannot write config to file"));
         TocataFS.remove(kPath);
+        return false;
     }
+    return true;
 }
 
 bool Config::operator==(const Config& other)
@@ -274,6 +434,32 @@ void Program::sendExpression(MidiSender& midi, uint8_t value, uint8_t global_cha
     midi.sendControl(expressionChannel(global_channel), expression(), value);
 }
 
+void Program::sendFineExpression(MidiSender& midi, uint16_t value, uint16_t previous, uint8_t global_channel) const
+{
+    const uint8_t channel = expressionChannel(global_channel);
+    const uint8_t msb = (value >> 7) & 0x7F;
+    const uint8_t lsb = value & 0x7F;
+    // Receivers reset the LSB on every MSB, so a new MSB always goes out as a
+    // pair; otherwise a single LSB message is enough
+    const bool new_msb = previous == kNoFineValue || (previous >> 7) != msb;
+    if (new_msb)
+    {
+        midi.sendControl(channel, _expression, msb);
+    }
+    if (new_msb || (previous & 0x7F) != lsb)
+    {
+        midi.sendControl(channel, _expression + 32, lsb);
+    }
+}
+
+void Program::loadNames()
+{
+    for (uint8_t id = 0; id < kMaxPrograms; ++id)
+    {
+        readName(id, sNames.programs[id]);
+    }
+}
+
 uint8_t Program::copyName(uint8_t id, char* name)
 {
 #if FAKE_CONFIG
@@ -281,30 +467,47 @@ uint8_t Program::copyName(uint8_t id, char* name)
     return strnlen(name, kMaxNameLength);
 #endif    
 
+    if (!sNames.loaded)
+    {
+        return readName(id, name);
+    }
+    if (id >= kMaxPrograms)
+    {
+        name[0] = 0;
+        return 0;
+    }
+    memcpy(name, sNames.programs[id], kMaxNameLength + 1);
+    return strnlen(name, kMaxNameLength);
+}
+
+uint8_t Program::readName(uint8_t id, char* name)
+{
     char path[kMaxPathSize];
     copyPath(id, path);
 
+    name[0] = 0;
     File file = TocataFS.open(path, FILE_READ);
     if (!file)
     {
         _logln(F("Cannot open to copy name"));
         return 0;
     }
-    size_t bytes_read = file.read((uint8_t*)name, kMaxNameLength + 1);
+    uint8_t header[kNameHeaderSize];
+    size_t bytes_read = file.read(header, sizeof(header));
     file.close();
 
-    if (bytes_read == 0)
-    {
-        return 0;
-    }
-
-    if (bytes_read != kMaxNameLength)
+    if (bytes_read != sizeof(header))
     {
         _logln(F("Invalid program file"));
         return 0;
     }
 
-    return strnlen(name, kMaxNameLength);
+    const char* stored_name;
+    uint8_t length;
+    findName(header, stored_name, length);
+    memcpy(name, stored_name, length);
+    name[length] = 0;
+    return length;
 }
 
 void Program::remove(uint8_t id, bool check)
@@ -325,6 +528,7 @@ void Program::remove(uint8_t id, bool check)
         Program current{id};
         if (!current.available())
         {
+            sNames.programs[id][0] = 0;
             return;
         }
     }
@@ -337,9 +541,13 @@ void Program::remove(uint8_t id, bool check)
     {
         _log(F("Cannot open program file to init"));
         _logln(path);
+        // A refused open keeps the old program; other failures may not.
+        // Either way copyName has to report what is on flash.
+        readName(id, sNames.programs[id]);
         return;
     }
     file.close();
+    sNames.programs[id][0] = 0;
 }
 
 bool Program::load(uint8_t id)
@@ -368,24 +576,79 @@ bool Program::load(uint8_t id)
         _logln(path);
         return false;
     }
-    size_t bytes_read = file.read((uint8_t*)this, sizeof(*this));
+    uint8_t buffer[kMaxCompactSize];
+    int body_size = readCompact(file, buffer, this, sizeof(*this));
     file.close();
 
-    if (bytes_read == 0)
+    if (body_size > 0)
     {
-        return false;
+        CompactReader reader{buffer, size_t(body_size)};
+        if (!decode(reader))
+        {
+            body_size = -1;
+        }
     }
 
-    if (bytes_read != sizeof(*this))
+    if (body_size < 0)
     {
         _log(F("Invalid program file "));
         _logln(path);
+        invalidate();
         return false;
     }
 
     return available();
 }
 
+void Program::encode(CompactWriter& writer) const
+{
+    writer.putString(_name, kMaxNameLength);
+    writer.put(_num_switches);
+    writer.put(_channel_and_mode);
+    writer.put(_expression);
+    _actions.encode(writer);
+
+    uint8_t available_mask = 0;
+    for (uint8_t i = 0; i < _num_switches; ++i)
+    {
+        available_mask |= _switches[i].available() ? (1 << i) : 0;
+    }
+    writer.put(available_mask);
+    for (uint8_t i = 0; i < _num_switches; ++i)
+    {
+        if (_switches[i].available())
+        {
+            _switches[i].encode(writer);
+        }
+    }
+}
+
+bool Program::decode(CompactReader& reader)
+{
+    memset(static_cast<void*>(this), 0, sizeof(*this));
+
+    uint8_t available_mask;
+    if (!(true
+        && reader.getString(_name, kMaxNameLength)
+        && reader.get(_num_switches)
+        && _num_switches <= kNumSwitches
+        && reader.get(&_channel_and_mode, sizeof(_channel_and_mode))
+        && reader.get(_expression)
+        && _actions.decode(reader)
+        && reader.get(available_mask)
+    )) return false;
+
+    for (uint8_t i = 0; i < _num_switches; ++i)
+    {
+        if ((available_mask & (1 << i)) && !_switches[i].decode(reader))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 uint8_t Program::defaultScene() const
 {
     // First enabled scene switch wins; else the first available scene switch
@@ -415,22 +678,22 @@ uint8_t Program::defaultScene() const
     return (first_scene < 0) ? 0 : uint8_t(first_scene);
 }
 
-void Program::save(uint8_t id) const
+bool Program::save(uint8_t id) const
 {
 #if FAKE_CONFIG
     memcpy(&sPrograms[id], this, sizeof(Program));
-    return;
+    return true;
 #endif
 
     if (!available())
     {
-        return;
+        return true;
     }
 
     Program current{id};
     if (current == *this)
     {
-        return;
+        return true;
     }
 
     char path[kMaxPathSize];
@@ -440,17 +703,25 @@ void Program::save(uint8_t id) const
     {
         _log(F("Cannot open program file to write "));
         _logln(path);
-        return;
+        return false;
     }
 
-    size_t written = file.write((uint8_t*)this, sizeof(*this));
+    uint8_t buffer[kCompactHeaderSize + kMaxCompactSize];
+    CompactWriter writer{buffer + kCompactHeaderSize, kMaxCompactSize};
+    encode(writer);
+    size_t written = writeCompact(file, buffer, writer);
     file.close();
 
-    if (written != sizeof(*this))
+    if (written == 0)
     {
         _log(F("Cannot write program to file "));
         _logln(path);
+        // Whatever made it to flash is what copyName has to report
+        readName(id, sNames.programs[id]);
+        return false;
     }
+    memcpy(sNames.programs[id], _name, kMaxNameLength + 1);
+    return true;
 }
 
 bool Program::operator==(const Program& other)
@@ -487,6 +758,44 @@ void Program::Footswitch::run(MidiSender& midi, bool active, uint8_t global_chan
     }
 }
 
+void Program::Footswitch::encode(CompactWriter& writer) const
+{
+    writer.putString(_name, kMaxNameSize);
+    writer.put(&_color, sizeof(_color));
+    writer.put(_enabled);
+    writer.put(&_mode, sizeof(_mode));
+    _on_actions.encode(writer);
+    _off_actions.encode(writer);
+}
+
+bool Program::Footswitch::decode(CompactReader& reader)
+{
+    return (true
+        && reader.getString(_name, kMaxNameSize)
+        && reader.get(&_color, sizeof(_color))
+        && reader.get(&_enabled, sizeof(_enabled))
+        && reader.get(&_mode, sizeof(_mode))
+        && _on_actions.decode(reader)
+        && _off_actions.decode(reader)
+    );
+}
+
+void Actions::encode(CompactWriter& writer) const
+{
+    const uint8_t num_actions = std::min<uint8_t>(_num_actions, kMaxActions);
+    writer.put(num_actions);
+    writer.put(_actions, num_actions * sizeof(Action));
+}
+
+bool Actions::decode(CompactReader& reader)
+{
+    return (true
+        && reader.get(_num_actions)
+        && _num_actions <= kMaxActions
+        && reader.get(_actions, _num_actions * sizeof(Action))
+    );
+}
+
 void Setlist::loadAll()
 {
     static constexpr char kAllName[] = "All";
@@ -500,7 +809,25 @@ void Setlist::loadAll()
     }
 }
 
+void Setlist::loadNames()
+{
+    for (uint8_t id = 0; id < kMaxSetlists; ++id)
+    {
+        sNames.setlist_sizes[id] = readName(id, sNames.setlists[id]);
+    }
+}
+
 uint8_t Setlist::copyName(uint8_t id, char* name)
+{
+    if (!sNames.loaded || id >= kMaxSetlists)
+    {
+        return readName(id, name);
+    }
+    memcpy(name, sNames.setlists[id], Program::kMaxNameLength + 1);
+    return sNames.setlist_sizes[id];
+}
+
+uint8_t Setlist::readName(uint8_t id, char* name)
 {
     name[0] = 0;
 
@@ -518,7 +845,7 @@ uint8_t Setlist::copyName(uint8_t id, char* name)
         return 0;
     }
 
-    uint8_t header[kHeaderSize];
+    uint8_t header[kNameHeaderSize];
     size_t bytes_read = file.read(header, sizeof(header));
     file.close();
 
@@ -529,10 +856,12 @@ uint8_t Setlist::copyName(uint8_t id, char* name)
         return 0;
     }
 
-    memcpy(name, header, Program::kMaxNameLength + 1);
-    name[Program::kMaxNameLength] = 0;
+    const char* stored_name;
+    uint8_t length;
+    const uint8_t num_programs = header[findName(header, stored_name, length)];
+    memcpy(name, stored_name, length);
+    name[length] = 0;
 
-    const uint8_t num_programs = header[Program::kMaxNameLength + 1];
     if (!name[0] || num_programs == 0 || num_programs > Program::kMaxPrograms)
     {
         name[0] = 0;
@@ -556,9 +885,11 @@ bool Setlist::load(uint8_t id)
         File file = TocataFS.open(path, FILE_READ);
         if (file)
         {
-            size_t bytes_read = file.read((uint8_t*)this, sizeof(*this));
+            uint8_t buffer[kMaxCompactSize];
+            int body_size = readCompact(file, buffer, this, sizeof(*this));
             file.close();
-            usable = bytes_read == sizeof(*this)
+            CompactReader reader{buffer, size_t(std::max(body_size, 0))};
+            usable = (body_size == 0 || (body_size > 0 && decode(reader)))
                 && available()
                 && _num_programs > 0
                 && _num_programs <= Program::kMaxPrograms;
@@ -590,6 +921,38 @@ int16_t Setlist::find(uint8_t program_id) const
     return -1;
 }
 
+bool IndexedSetlist::load(uint8_t id)
+{
+    const bool usable = Setlist::load(id);
+    _all = !usable;
+    if (usable)
+    {
+        index();
+    }
+    return usable;
+}
+
+void IndexedSetlist::loadAll()
+{
+    Setlist::loadAll();
+    _all = true;
+}
+
+void IndexedSetlist::index()
+{
+    memset(_positions, kNotFound, sizeof(_positions));
+    // Backwards, so a program listed twice resolves to its first position,
+    // like a scan would
+    for (uint8_t pos = numPrograms(); pos-- > 0;)
+    {
+        const uint8_t id = _programs[pos];
+        if (id < Program::kMaxPrograms)
+        {
+            _positions[id] = pos;
+        }
+    }
+}
+
 void Setlist::remove(uint8_t id)
 {
     if (id >= kMaxSetlists)
@@ -605,6 +968,8 @@ void Setlist::remove(uint8_t id)
     // slot outright instead of leaving an empty file behind. That keeps the file
     // table small on the short pedal, where one 64K block holds just 127 files.
     TocataFS.remove(path);
+    sNames.setlists[id][0] = 0;
+    sNames.setlist_sizes[id] = 0;
 }
 
 void Setlist::removeAll()
@@ -615,17 +980,21 @@ void Setlist::removeAll()
     }
 }
 
-void Setlist::save(uint8_t id) const
+bool Setlist::save(uint8_t id) const
 {
-    if (id >= kMaxSetlists || !available() || _num_programs == 0)
+    if (id >= kMaxSetlists)
     {
-        return;
+        return false;
+    }
+    if (!available() || _num_programs == 0)
+    {
+        return true;
     }
 
     Setlist current;
     if (current.load(id) && current == *this)
     {
-        return;
+        return true;
     }
 
     char path[Program::kMaxPathSize];
@@ -636,18 +1005,41 @@ void Setlist::save(uint8_t id) const
     {
         _log(F("Cannot open setlist file to write "));
         _logln(path);
-        return;
+        return false;
     }
 
-    size_t written = file.write((const uint8_t*)this, sizeof(*this));
+    uint8_t buffer[kCompactHeaderSize + kMaxCompactSize];
+    CompactWriter writer{buffer + kCompactHeaderSize, kMaxCompactSize};
+    encode(writer);
+    size_t written = writeCompact(file, buffer, writer);
     file.close();
 
-    if (written != sizeof(*this))
+    if (written == 0)
     {
         _log(F("Cannot write setlist to file "));
         _logln(path);
         TocataFS.remove(path);
     }
+    // Back through readName, which applies the selectability rules
+    sNames.setlist_sizes[id] = readName(id, sNames.setlists[id]);
+    return written != 0;
+}
+
+void Setlist::encode(CompactWriter& writer) const
+{
+    writer.putString(_name, Program::kMaxNameLength);
+    writer.put(_num_programs);
+    writer.put(_programs, _num_programs);
+}
+
+bool Setlist::decode(CompactReader& reader)
+{
+    return (true
+        && reader.getString(_name, Program::kMaxNameLength)
+        && reader.get(_num_programs)
+        && _num_programs <= Program::kMaxPrograms
+        && reader.get(_programs, _num_programs)
+    );
 }
 
 bool Setlist::operator==(const Setlist& other) const
@@ -18,11 +18,14 @@ inline void copyFilePath(uint8_t file_id, char* path)
 }
 
 class MidiSender;
+class CompactWriter;
+class CompactReader;
 
 class Storage
 {
 public:
     static void init();
+    static void run();
     static void factoryReset();
 };
 
@@ -66,7 +69,8 @@ public:
     MidiConfig& midi() { return _midi; }
     const ExpressionConfig& expression() const { return _expression; }
     ExpressionConfig& expression() { return _expression; }
-    void save() const;
+    // False when the filesystem is full and refused it: what was stored stays
+    bool save() const;
     bool operator==(const Config& other);
 
 protected:
@@ -100,6 +104,8 @@ public:
 
     void run(MidiSender& midi, uint8_t global_channel) const;
     bool operator==(const Actions& other);
+    void encode(CompactWriter& writer) const;
+    bool decode(CompactReader& reader);
 
     class Action
     {
@@ -175,6 +181,7 @@ public:
             kMomentary = 1,  // on while pressed, off when released
             kScene = 2,      // mutually exclusive among scene switches
             kProgram = 3,    // pure trigger: enters program-change mode, no actions
+            kTapTempo = 4,   // sets the MIDI clock tempo; on actions run on every tap
         };
 
         const char* name() const { return _name; }
@@ -185,6 +192,8 @@ public:
         bool available() const { return _name[0]; }
         void run(MidiSender& midi, bool active, uint8_t global_channel) const;
         bool operator==(const Footswitch& other);
+        void encode(CompactWriter& writer) const;
+        bool decode(CompactReader& reader);
 
     private:
         Actions _on_actions;
@@ -195,6 +204,7 @@ public:
         Mode _mode;
     } __attribute__((packed));
 
+    // Served from the in-RAM name directory once Storage::init has built it
     static uint8_t copyName(uint8_t id, char* name);
     static void remove(uint8_t id) { remove(id, true); };
 
@@ -209,7 +219,7 @@ public:
     const Footswitch& footswitch(uint8_t id) const { return _switches[id]; }
     uint8_t numFootswitches() const { return _num_switches; }
     const char* name() const { return _name; }
-    Mode mode() const { return Mode(_channel_and_mode & 0x07); }
+    Mode mode() const { return Mode(_channel_and_mode & kModeMask); }
     // Effective mode of a single switch: kScene programs force every switch to
     // scene; kDefault programs defer to the switch's own stored mode.
     Footswitch::Mode switchMode(uint8_t id) const
@@ -225,25 +235,40 @@ public:
         return (expressionGlobalChannel() ? global_channel : (_channel_and_mode >> 4)) & 0x0F;
     }
     bool expressionEnabled() const { return _expression < 128; }
+    // 14 bit expression: CC n carries the MSB and CC n + 32 the LSB, which
+    // the MIDI spec only defines for n in 0..31
+    bool expressionHighRes() const { return (_channel_and_mode & kExpressionHighResMask) && _expression < 32; }
+    static constexpr uint16_t kNoFineValue = UINT16_MAX;
+    // Sends only what changed since `previous` (kNoFineValue for a full pair)
+    void sendFineExpression(MidiSender& midi, uint16_t value, uint16_t previous, uint8_t global_channel) const;
     bool available() const { return _name[0]; }
-    void save(uint8_t id) const;
+    // False when it couldn't be written, e.g. on a full filesystem
+    bool save(uint8_t id) const;
     bool operator==(const Program& other);
 
 protected:
     friend class Storage;
     static void initAll();
+    static void loadNames();
 
 private:
     static void remove(uint8_t id, bool check);
+    static uint8_t readName(uint8_t id, char* name);
     // Offset by one: file id 0 ("/00") belongs to Config.
     static void copyPath(uint8_t id, char* path) { copyFilePath(id + 1, path); }
     void invalidate() { _name[0] = 0; }
+    void encode(CompactWriter& writer) const;
+    bool decode(CompactReader& reader);
 
     char _name[kMaxNameLength + 1] = "";
     uint8_t _num_switches;
     Footswitch _switches[kNumSwitches];
     Actions _actions;
-    Mode _channel_and_mode; // Expression channel in first most significant 4 bits
+    // Bits 0-1 mode, bit 2 kExpressionHighResMask, bit 3 kGlobalChannelMask and
+    // the expression channel in the 4 most significant bits
+    static constexpr uint8_t kModeMask = 0x03;
+    static constexpr uint8_t kExpressionHighResMask = 0x04;
+    Mode _channel_and_mode;
     uint8_t _expression;
 } __attribute__((packed));
 
@@ -258,9 +283,10 @@ public:
     // and the 99 programs (see copyFilePath).
     static constexpr uint8_t kMaxSetlists = 26;
 
-    // Copies the name of setlist `id` and returns its program count. Reads only
-    // the 32-byte header, so it is cheap enough to probe every slot. A return of
-    // 0 means missing, unnamed or empty -- i.e. not selectable.
+    // Copies the name of setlist `id` and returns its program count. Comes
+    // from the in-RAM name directory, so it is cheap enough to probe every
+    // slot. A return of 0 means missing, unnamed or empty -- i.e. not
+    // selectable.
     static uint8_t copyName(uint8_t id, char* name);
     static void remove(uint8_t id);
     static void removeAll();
@@ -283,19 +309,55 @@ public:
     }
     // Position of `program_id` within the setlist, or -1 when it isn't in it.
     int16_t find(uint8_t program_id) const;
-    void save(uint8_t id) const;
+    // False when it couldn't be written, like Program::save
+    bool save(uint8_t id) const;
     bool operator==(const Setlist& other) const;
 
+protected:
+    friend class Storage;
+    static void loadNames();
+
 private:
     static constexpr uint8_t kFirstFileId = 0x64;
-    static constexpr size_t kHeaderSize = Program::kMaxNameLength + 2;
 
+    static uint8_t readName(uint8_t id, char* name);
     static void copyPath(uint8_t id, char* path) { copyFilePath(kFirstFileId + id, path); }
     void invalidate() { _name[0] = 0; }
+    void encode(CompactWriter& writer) const;
+    bool decode(CompactReader& reader);
 
+protected:
     char _name[Program::kMaxNameLength + 1] = "";
     uint8_t _num_programs = 0;
     uint8_t _programs[Program::kMaxPrograms] = {};
 } __attribute__((packed));
 
+// The setlist the pedal navigates, plus the inverse program id -> position
+// table so incoming program changes resolve without scanning. The table can't
+// live in Setlist itself, whose layout is both the USB payload and the legacy
+// file format. "All" needs no table at all: position and program id coincide.
+class IndexedSetlist : public Setlist
+{
+public:
+    bool load(uint8_t id);
+    void loadAll();
+
+    // Position of `program_id` within the setlist, or -1 when it isn't in it
+    int16_t find(uint8_t program_id) const
+    {
+        if (program_id >= Program::kMaxPrograms) { return -1; }
+        if (_all) { return program_id; }
+        const uint8_t pos = _positions[program_id];
+        return (pos == kNotFound) ? -1 : int16_t(pos);
+    }
+
+private:
+    static constexpr uint8_t kNotFound = 0xFF;
+
+    void index();
+
+    uint8_t _positions[Program::kMaxPrograms] = {};
+    bool _all = true;   // Setlist() starts out as "All"
+};
+
 }
\ No newline at end of file
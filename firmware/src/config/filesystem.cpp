@@ -1,7 +1,16 @@
 #include "filesystem.h"
+#include <algorithm>
 #include <cstring>
 #include <assert.h>
 
+// Block erases, index updates and init steps are logged as they happen. Host
+// benchmarks doing thousands of them build with FS_QUIET.
+#if FS_QUIET
+#define FS_LOG(...) ((void)0)
+#else
+#define FS_LOG(...) printf(__VA_ARGS__)
+#endif
+
 #if MEMFS
 namespace tocata {
 File::Content File::files[File::kNumFiles] = {};
@@ -49,19 +58,25 @@ void FS::test()
 
 bool FS::init(bool formatOnFail)
 {
-    printf("Initializing filesystem...\n");
+    FS_LOG("Initializing filesystem...\n");
     if (!_block.init(&_partition, formatOnFail))
     {
         return false;
     }
 
     _used_bytes = 0;
+    _stats = {};
+    _free_files = 0;
+    _invalid_files = 0;
+    _collect_block = Block::kInvalidId;
+    _extra_block_id = Block::kInvalidId;
 
     uint32_t extra_block_cycles = UINT32_MAX;
     // Read backwards to finish with block 0
     for (uint8_t i = _block.numBlocks(); i > 0; --i)
     {
         _block.load(i - 1);
+        _free_files += _block.freeFiles();
         if (_block.isEmpty())
         {
             if (_block.cycles() < extra_block_cycles)
@@ -73,14 +88,32 @@ bool FS::init(bool formatOnFail)
         else
         {
             _used_bytes += _block.usedBytes();
+            _invalid_files += _block.invalidFiles();
         }        
     }
-    if (_extra_block_id == 0)
+
+    if (_extra_block_id == Block::kInvalidId)
     {
-        _block.load(1);
+        FS_LOG("No extra block\n");
+        return false;
     }
 
-    printf("Extra block %u\n", _extra_block_id);
+    // A collection interrupted by a reset leaves copied files behind an
+    // unwritten index
+    if (!_block.isBlank(_extra_block_id))
+    {
+        FS_LOG("Extra block %u not blank\n", _extra_block_id);
+        _block.erase(_extra_block_id);
+    }
+    // Every empty block was counted as free space, but the spare one is not
+    _free_files -= Block::kFilesPerBlock;
+
+    if (_block.id() == _extra_block_id)
+    {
+        _block.load(_extra_block_id == 0 ? 1 : 0);
+    }
+
+    FS_LOG("Extra block %u\n", _extra_block_id);
 
     return true;
 }
@@ -90,6 +123,8 @@ File FS::open(const char* path, const char* mode)
     bool write = (mode[0] == 'w');
     auto nibble = [](char c) { return c <= '9' ? c - '0' : c - 'A' + 10; };
     uint8_t file_id = (nibble(path[1]) << 4) | nibble(path[2]);
+    // Before looking the file up: compaction can move it
+    bool room = write && makeRoom();
     uint8_t first_block = _block.id();
     File file = _block.open(file_id);
     if (!file)
@@ -118,12 +153,23 @@ File FS::open(const char* path, const char* mode)
     bool existed = file;
     if (existed)
     {
-        if (file.isEmpty())
+        // A file in the block being collected may already have been copied,
+        // and content written here would not follow it
+        if (file.isEmpty() && file.blockId() != _collect_block)
         {
             return file;
         }
+    }
 
-        _block.invalidateFile(file);
+    if (!room)
+    {
+        // Full: the current content stays
+        return {};
+    }
+
+    if (existed)
+    {
+        invalidate(file);
     }
 
     file = create(file_id);
@@ -136,12 +182,30 @@ File FS::open(const char* path, const char* mode)
 }
 
 File FS::create(uint8_t file_id)
+{
+    uint8_t block_id = findSpace();
+    if (block_id == Block::kInvalidId)
+    {
+        return {};
+    }
+
+    _block.load(block_id);
+    File file = _block.createFile(file_id);
+    if (file)
+    {
+        --_free_files;
+        ++_stats.files_created;
+    }
+    return file;
+}
+
+uint8_t FS::findSpace()
 {
     uint32_t min_cycles = UINT32_MAX;
     uint8_t available_block = Block::kInvalidId;
     for (uint8_t id = 0; id < _block.numBlocks(); ++id)
     {
-        if (id == _extra_block_id)
+        if (id == _extra_block_id || id == _collect_block)
         {
             continue;
         }
@@ -153,14 +217,56 @@ File FS::create(uint8_t file_id)
             min_cycles = cycles;
         }
     }
+    return available_block;
+}
+
+void FS::run()
+{
+    if (_collect_block == Block::kInvalidId && !startCollection())
+    {
+        return;
+    }
+
+    collect(kCollectFilesPerRun);
+}
+
+bool FS::makeRoom()
+{
+    if (findSpace() != Block::kInvalidId)
+    {
+        return true;
+    }
+
+    // The writes outran the background compaction and no slot is left: finish
+    // it here, or compact a block from scratch, like every write that found
+    // the filesystem full used to. Only refused when nothing is reclaimable.
+    ++_stats.assists;
+    while (findSpace() == Block::kInvalidId)
+    {
+        if (_collect_block == Block::kInvalidId && !startCollection())
+        {
+            ++_stats.refused;
+            return false;
+        }
+        collect(Block::kFilesPerBlock);
+    }
+    return true;
+}
 
-    if (available_block != Block::kInvalidId)
+bool FS::startCollection()
+{
+    const size_t free_files = usableFiles();
+    if (free_files >= kCollectWatermark || _invalid_files == 0)
     {
-        _block.load(available_block);
-        return _block.createFile(file_id);
+        return false;
     }
 
-    min_cycles = UINT32_MAX;
+    // Erasing a block for a slot or two costs as much wear as for a hundred:
+    // wait for more to reclaim, unless the free slots are all but gone
+    const size_t min_invalid = (free_files < kCollectUrgent) ? 1 : kCollectMinReclaim;
+    size_t most_invalid = 0;
+    uint32_t min_cycles = UINT32_MAX;
+    uint8_t collect_block = Block::kInvalidId;
     for (uint8_t id = 0; id < _block.numBlocks(); ++id)
     {
         if (id == _extra_block_id)
@@ -169,26 +275,100 @@ File FS::create(uint8_t file_id)
         }
 
         _block.load(id);
-        if (_block.cycles() < min_cycles && _block.canReuse())
+        const size_t invalid = _block.invalidFiles();
+        if (invalid < min_invalid)
+        {
+            continue;
+        }
+
+        if (invalid > most_invalid || (invalid == most_invalid && _block.cycles() < min_cycles))
         {
+            most_invalid = invalid;
             min_cycles = _block.cycles();
-            available_block = _block.id();
+            collect_block = _block.id();
         }
     }
 
-    if (available_block == Block::kInvalidId)
+    if (collect_block == Block::kInvalidId)
     {
-        // Filesystem full
-        return {};
+        return false;
     }
 
-    _block.load(available_block);
-    _block.compactInto(_extra_block_id);
-    _block.erase();
-    _block.load(_extra_block_id);
-    _extra_block_id = available_block;
+    _block.load(collect_block);
+    _collect_free_files = _block.freeFiles();
+    _collect_block = collect_block;
+    _collect_src_index = 0;
+    _collect_dst_index = 0;
+    memset(_collect_flags, 0xFF, sizeof(_collect_flags));
+    return true;
+}
 
-    return _block.createFile(file_id);
+bool FS::collect(size_t max_files)
+{
+    _block.load(_collect_block);
+
+    size_t copied = 0;
+    while (_collect_src_index < Block::kFilesPerBlock && copied < max_files)
+    {
+        uint8_t index = _collect_src_index++;
+        if (_block.copyFile(index, _extra_block_id, _collect_dst_index))
+        {
+            _collect_flags[_collect_dst_index++] = _block.flags(index);
+            ++copied;
+            ++_stats.files_copied;
+        }
+    }
+
+    if (_collect_src_index < Block::kFilesPerBlock)
+    {
+        return false;
+    }
+
+    // Every live file has a copy: publish the new index, then recycle the source
+    _block.writeFlags(_extra_block_id, _collect_flags, _collect_dst_index);
+
+    _free_files += (Block::kFilesPerBlock - _collect_dst_index) - _block.freeFiles();
+    _invalid_files -= _block.invalidFiles();
+    for (uint8_t i = 0; i < _collect_dst_index; ++i)
+    {
+        if (File::isInvalid(_collect_flags[i]))
+        {
+            ++_invalid_files;
+        }
+    }
+
+    ++_stats.collections;
+    uint8_t collected_block = _collect_block;
+    _collect_block = Block::kInvalidId;
+    _block.erase(collected_block);
+    _extra_block_id = collected_block;
+    return true;
+}
+
+void FS::invalidate(File& file)
+{
+    _block.load(file.blockId());
+    if (file.blockId() == _collect_block && file.index() < _collect_src_index)
+    {
+        forgetCopy(File::idFromFlags(file.flags()));
+    }
+
+    _block.invalidateFile(file);
+    ++_invalid_files;
+}
+
+void FS::forgetCopy(uint8_t file_id)
+{
+    // Only one live copy of an id exists
+    for (uint8_t i = 0; i < _collect_dst_index; ++i)
+    {
+        uint8_t flags = _collect_flags[i];
+        if (!File::isAvailable(flags) && File::idFromFlags(flags) == file_id)
+        {
+            _collect_flags[i] = File::kInvalid;
+            break;
+        }
+    }
 }
 
 void FS::remove(const char* path)
@@ -199,8 +379,7 @@ void FS::remove(const char* path)
         return;
     }
 
-    _block.load(file.blockId());
-    _block.invalidateFile(file);
+    invalidate(file);
     _used_bytes -= _block.bytesPerFile();
 }
 
@@ -213,7 +392,9 @@ size_t FS::read(File& file, void* dst, size_t size)
 size_t FS::write(File& file, const void* src, size_t size)
 {
     _block.load(file.blockId());
-    return _block.write(file, src, size);
+    const size_t written = _block.write(file, src, size);
+    _stats.bytes_written += uint32_t(written);
+    return written;
 }
 
 bool FS::Block::init(const FlashPartition* partition, bool formatOnFail)
@@ -223,13 +404,13 @@ bool FS::Block::init(const FlashPartition* partition, bool formatOnFail)
     Descriptor::Header header;
     for (uint8_t id = 0; id < numBlocks(); ++id)
     {
-        auto ret = _partition->read(offset(id), &header, sizeof(header));
+        [[maybe_unused]] auto ret = _partition->read(offset(id), &header, sizeof(header));
         assert(ret);
 
         if (header.isValid())
         {
             _cycles[id] = header.cycles;
-            printf("Found block %u cycles %u\n", id, cycles(id));
+            FS_LOG("Found block %u cycles %u\n", id, cycles(id));
         }
         else
         {
@@ -249,7 +430,7 @@ void FS::Block::load(uint8_t id)
     if (_id != id)
     {
         _id = id;
-        auto ret = _partition->read(indexOffset(0), &_cached_flags, sizeof(_cached_flags));
+        [[maybe_unused]] auto ret = _partition->read(indexOffset(0), &_cached_flags, sizeof(_cached_flags));
         assert(ret);
     }
 }
@@ -260,14 +441,14 @@ void FS::Block::erase(uint8_t id)
     Descriptor::Header header;
     header.cycles = ++_cycles[id];
 
-    auto ret = _partition->erase(offset(), size());
+    [[maybe_unused]] auto ret = _partition->erase(offset(), size());
     assert(ret);
     ret = _partition->write(offset(), &header, sizeof(header));
     assert(ret);
 
     memset(_cached_flags, 0xFF, kFilesPerBlock);
 
-    printf("Erased block %u cycles %u\n", _id, cycles());
+    FS_LOG("Erased block %u cycles %u\n", _id, cycles());
 }
 
 File FS::Block::open(uint8_t file_id)
@@ -300,7 +481,7 @@ File FS::Block::createFile(uint8_t file_id)
             return {_fs, _id, i, flags};
         }
     }
-    printf("Cannot create file %u in block %u\n", file_id, _id);
+    FS_LOG("Cannot create file %u in block %u\n", file_id, _id);
     return {};
 }
 
@@ -313,44 +494,60 @@ void FS::Block::invalidateFile(File& file)
 void FS::Block::updateFlags(uint8_t index, uint8_t flags)
 {
     _cached_flags[index] = flags;
-    auto ret = _partition->write(indexOffset(index), &flags, sizeof(flags));
+    [[maybe_unused]] auto ret = _partition->write(indexOffset(index), &flags, sizeof(flags));
     assert(ret); 
     ret = _partition->write(fileOffset(index), &flags, sizeof(flags));
     assert(ret);
-    printf("update block %u index %u flags %02X\n", _id, index, flags);
+    FS_LOG("update block %u index %u flags %02X\n", _id, index, flags);
 }
 
-void FS::Block::compactInto(uint8_t dst_block_id)
+bool FS::Block::copyFile(uint8_t index, uint8_t dst_block_id, uint8_t dst_index)
 {
-    size_t dst_offset = dst_block_id * kBlockSize;
-    size_t dst_flags_off = dst_offset + sizeof(((Descriptor*)0)->header);
-    size_t dst_file_off = dst_offset + kFileSize;
+    uint8_t flags = _cached_flags[index];
+    if (File::isAvailable(flags))
+    {
+        return false;
+    }
 
-    uint8_t file_content[kFileSize];
-    for (uint8_t i = 0; i < kFilesPerBlock; ++i)
+    if (!File::isEmpty(flags))
     {
-        uint8_t flags = _cached_flags[i];
-        if (File::isAvailable(flags))
-        {
-            continue;
-        }
+        // The whole slot, so the content lands at the same offset past the
+        // per-file flags byte
+        uint8_t file_content[kFileSize];
+        [[maybe_unused]] auto ret = _partition->read(fileOffset(index), file_content, kFileSize);
+        assert(ret);
+        ret = _partition->write(fileOffset(dst_block_id, dst_index), file_content, kFileSize);
+        assert(ret);
+    }
+    return true;
+}
+
+void FS::Block::writeFlags(uint8_t block_id, const uint8_t* flags, size_t count)
+{
+    assert(block_id != _id);
+    [[maybe_unused]] auto ret = _partition->write(indexOffset(block_id, 0), flags, count);
+    assert(ret);
+}
 
-        auto ret = _partition->write(dst_flags_off++, &flags, sizeof(flags));
+bool FS::Block::isBlank(uint8_t block_id) const
+{
+    uint8_t chunk[kFileSize];
+    for (size_t offs = sizeof(Descriptor::Header); offs < kBlockSize; offs += sizeof(chunk))
+    {
+        size_t size = std::min(sizeof(chunk), kBlockSize - offs);
+        [[maybe_unused]] auto ret = _partition->read(offset(block_id) + offs, chunk, size);
         assert(ret);
-        if (!File::isEmpty(flags))
+        if (std::any_of(chunk, chunk + size, [](uint8_t b) { return b != 0xFF; }))
         {
-            ret = _partition->read(fileContentOffset(i), file_content, kFileSize);
-            assert(ret);
-            ret = _partition->write(dst_file_off, file_content, kFileSize);
-            assert(ret);
+            return false;
         }
-        dst_file_off += kFileSize;
     }
-}   
+    return true;
+}
 
 size_t FS::Block::read(File& file, void* dst, size_t size)
 {
-    if (size > bytesPerFile())
+    if (file._offset + size > bytesPerFile())
     {
         return 0;
     }
@@ -361,16 +558,17 @@ size_t FS::Block::read(File& file, void* dst, size_t size)
     }
     else
     {
-        auto ret = _partition->read(fileContentOffset(file.index()), dst, size);
+        [[maybe_unused]] auto ret = _partition->read(fileContentOffset(file.index()) + file._offset, dst, size);
         assert(ret);
     }
 
+    file._offset += size;
     return size;
 }
 
 size_t FS::Block::write(File& file, const void* src, size_t size)
 {
-    if (size > bytesPerFile())
+    if (file._offset + size > bytesPerFile())
     {
         return 0;
     }
@@ -381,9 +579,10 @@ size_t FS::Block::write(File& file, const void* src, size_t size)
         updateFlags(file.index(), file.flags());
     }
 
-    auto ret = _partition->write(fileContentOffset(file.index()), src, size);
+    [[maybe_unused]] auto ret = _partition->write(fileContentOffset(file.index()) + file._offset, src, size);
     assert(ret);
 
+    file._offset += size;
     return size;
 }
 
@@ -391,7 +590,7 @@ bool FS::Block::hasSpace(uint8_t block_id) const
 {
     size_t last_flags_offset = indexOffset(block_id, kFilesPerBlock - 1);
     uint8_t flags;
-    auto ret = _partition->read(last_flags_offset, &flags, sizeof(flags));
+    [[maybe_unused]] auto ret = _partition->read(last_flags_offset, &flags, sizeof(flags));
     assert(ret);
 
     return File::isFree(flags);
@@ -418,16 +617,17 @@ size_t FS::Block::usedBytes() const
 }
 
 
-bool FS::Block::canReuse() const
+size_t FS::Block::countFiles(bool (*predicate)(uint8_t)) const
 {
+    size_t count = 0;
     for (uint8_t i = 0; i < kFilesPerBlock; ++i)
     {
-        if (File::isAvailable(_cached_flags[i]))
+        if (predicate(_cached_flags[i]))
         {
-            return true;
+            ++count;
         }
     }
-    return false;
+    return count;
 }
 
 }
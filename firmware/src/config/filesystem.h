@@ -16,6 +16,7 @@ class FS;
 
 class File {
 public:
+    // Reads and writes continue where the previous one on this handle ended
     size_t read(void* dst, size_t size);
     size_t write(const void* src, size_t size);
     bool isEmpty() const { return isEmpty(_flags); }
@@ -53,6 +54,7 @@ private:
     uint8_t _block_id;
     uint8_t _index;
     uint8_t _flags;
+    uint16_t _offset = 0;
 };
 
 
@@ -64,6 +66,13 @@ private:
 public:
     FS() : _block(this) {}
     bool init(bool formatOnFail = false);
+    // Where init() looks for blocks: the board's partition by default. Host
+    // benchmarks set other geometries here before init().
+    void setPartition(const FlashPartition& partition) { _partition = partition; }
+    // Background compaction: copies a few files per call into the spare block
+    // once free slots run low, and erases the compacted block when done. A
+    // write only compacts itself when no free slot is left at all.
+    void run();
     void test();
     void printUsage();
     File open(const char* path, const char* mode = FILE_READ);
@@ -71,6 +80,18 @@ public:
     bool exists(const char* path) { return open(path, FILE_READ); }
     size_t usedBytes() const { return _used_bytes; }
     size_t totalBytes() const { return (_block.numBlocks() - 1) * _block.totalBytes(); }
+
+    // Counters since init(), for measuring the filesystem on the host
+    struct Stats
+    {
+        uint32_t bytes_written;     // file content handed to write()
+        uint32_t files_created;
+        uint32_t collections;       // blocks compacted, in the background or not
+        uint32_t files_copied;      // live files moved by compaction
+        uint32_t assists;           // writes that found no free slot and compacted first
+        uint32_t refused;           // writes turned away with nothing left to reclaim
+    };
+    const Stats& stats() const { return _stats; }
     
 protected:
     friend class File;
@@ -98,7 +119,9 @@ private:
         File open(uint8_t file_id);
         File createFile(uint8_t file_id);
         void invalidateFile(File& file);
-        void compactInto(uint8_t block_id);
+        bool copyFile(uint8_t index, uint8_t dst_block_id, uint8_t dst_index);
+        void writeFlags(uint8_t block_id, const uint8_t* flags, size_t count);
+        bool isBlank(uint8_t block_id) const;
         size_t read(File& file, void* dst, size_t size);
         size_t write(File& file, const void* src, size_t size);
         bool isEmpty() const { return _cached_flags[0] == File::kFree; }
@@ -109,7 +132,9 @@ private:
         uint8_t id() const { return _id; }
         uint8_t cycles() const { return cycles(_id); }
         uint8_t cycles(uint8_t id) const { return _cycles[id]; }
-        bool canReuse() const;
+        uint8_t flags(uint8_t index) const { return _cached_flags[index]; }
+        size_t freeFiles() const { return countFiles(File::isFree); }
+        size_t invalidFiles() const { return countFiles(File::isInvalid); }
         uint8_t numBlocks() const { return _partition->size() / kBlockSize; }
 
     private:
@@ -133,6 +158,7 @@ private:
         static size_t indexOffset(uint8_t id, uint8_t index) { return offset(id) + sizeof(((Descriptor*)0)->header) + index; }
 
         void updateFlags(uint8_t index, uint8_t flag);
+        size_t countFiles(bool (*predicate)(uint8_t)) const;
         size_t offset() const { return offset(_id); }
         size_t fileOffset(uint8_t index) const { return fileOffset(_id, index); }
         size_t fileContentOffset(uint8_t index) const { return fileContentOffset(_id, index); }
@@ -145,12 +171,43 @@ private:
         uint8_t _id = kInvalidId;
     };
 
+    // Start compacting once fewer free slots than this remain
+    static constexpr size_t kCollectWatermark = 16;
+    // Only compact a block with at least this many invalid slots, until fewer
+    // than kCollectUrgent free slots remain
+    static constexpr size_t kCollectMinReclaim = 8;
+    static constexpr size_t kCollectUrgent = 4;
+    static constexpr size_t kCollectFilesPerRun = 2;
+
     File create(uint8_t file_id);
+    uint8_t findSpace();
+    // Free slots a new file can go to: not those of the block being collected
+    size_t usableFiles() const
+    {
+        return _free_files - (_collect_block == Block::kInvalidId ? 0 : _collect_free_files);
+    }
+    bool makeRoom();
+    bool startCollection();
+    bool collect(size_t max_files);
+    void invalidate(File& file);
+    void forgetCopy(uint8_t file_id);
 
     Block _block;
     size_t _used_bytes;
+    size_t _free_files;
+    size_t _invalid_files;
     uint8_t _extra_block_id;
+
+    // Block being compacted into _extra_block_id. Its index is kept in RAM and
+    // only written once every live file has been copied, so an interrupted
+    // collection leaves the spare block looking empty.
+    uint8_t _collect_block = Block::kInvalidId;
+    uint8_t _collect_src_index;
+    uint8_t _collect_dst_index;
+    uint8_t _collect_free_files;
+    uint8_t _collect_flags[Block::kFilesPerBlock];
     FlashPartition _partition{};
+    Stats _stats{};
 };
 
 extern FS TocataFS;
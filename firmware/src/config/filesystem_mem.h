@@ -15,7 +15,7 @@ class File {
 public:
     size_t read(void* dst, size_t size)
     {
-        assert(size <= sizeof(content()->bytes));
+        assert(_offset + size <= sizeof(content()->bytes));
         // printf("read file %u bytes from %u\n", (uint32_t)size, _fd);
 
         if (!content() || content()->state == kNoFile)
@@ -29,15 +29,16 @@ public:
         }
         else
         {
-            memcpy(dst, content()->bytes, size);
+            memcpy(dst, content()->bytes + _offset, size);
         }
 
+        _offset += size;
         return size;
     }
 
     size_t write(const void* src, size_t size)
     {
-        assert(size <= sizeof(content()->bytes));
+        assert(_offset + size <= sizeof(content()->bytes));
         // printf("write file %u bytes to %u\n", (uint32_t)size, _fd);
 
         if (!content() || content()->state == kNoFile || size == 0)
@@ -45,8 +46,9 @@ public:
             return 0;
         }
         content()->state = kUsed;
-        memcpy(content()->bytes, src, size);
+        memcpy(content()->bytes + _offset, src, size);
 
+        _offset += size;
         return size;
     }
 
@@ -118,12 +120,14 @@ private:
     const Content* content() const { return _fd == kInvalidFile ? nullptr : &files[_fd]; }
 
     uint8_t _fd;
+    uint16_t _offset = 0;
 };
 
 class FS
 {
 public:
     bool init(bool formatOnFail = false) { return true; }
+    void run() {}
     File open(const char* path, const char* mode = FILE_READ)
     {
         assert(mode && mode[1] == '\0' && (mode[0] == 'r' || mode[0] == 'w'));
@@ -4,7 +4,9 @@
 
 namespace tocata {
 
-FlashPartition::FlashPartition() : _part_offset(kFlashPartitionOffset) {}
+FlashPartition::FlashPartition(uint32_t offset, uint32_t size) : _part_offset(offset), _part_size(size) {}
+
+FlashPartition::FlashPartition() : FlashPartition(kFlashPartitionOffset, kFlashPartitionSize) {}
 
 bool FlashPartition::read(size_t src_offset, void* dst_buf, size_t dst_size) const
 {
@@ -65,7 +67,7 @@ bool FlashPartition::erase(size_t offset, size_t size) const
 
 size_t FlashPartition::size() const
 {
-    return kFlashPartitionSize;
+    return _part_size;
 }
 
 
@@ -7,7 +7,10 @@ namespace tocata {
 
 class FlashPartition {
 public:
+    // kFlashPartitionOffset and kFlashPartitionSize, the HAL's partition
     FlashPartition();
+    // Any other geometry, for host benchmarks
+    FlashPartition(uint32_t offset, uint32_t size);
     bool read(size_t src_offset, void* dst_buf, size_t dst_size) const;
     bool write(size_t dst_offset, const void* src_buf, size_t src_size) const;
     bool erase(size_t offset, size_t size) const;
@@ -17,6 +20,7 @@ private:
     size_t writePage(size_t dst_offset, const void* src_buf, size_t src_size) const;
 
     uint32_t _part_offset = 0;
+    uint32_t _part_size = 0;
 };
 
 }
\ No newline at end of file
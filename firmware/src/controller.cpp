@@ -13,8 +13,12 @@ namespace tocata {
 void Controller::init()
 {
     _usb.init();
+    // The HAL sends the MIDI clock to USB itself (see midi_clock_start)
+    _midi_out.addDestination(_usb.midi(), {.types = MidiFilter::kAll & ~MidiFilter::kRealtime}, kUsbControlRate);
+    _midi_out.addDestination(_network.midi(), {}, kNetworkControlRate);
     _usb.midi().setCallback(std::bind(&Controller::midiCallback, this, _1, _2, _3));
     _display.init();
+    _display.setFrameBudget(kDisplayBudgetUs);
     //
     Storage::init();
     _config.load();
@@ -53,12 +57,19 @@ void Controller::init()
     _network.midi().setCallback(std::bind(&Controller::midiCallback, this, _1, _2, _3));
     _network.setOnLinkUp([this]{
         sendIdentityReply(_network.midi());
-        sendExpression(_exp.getValue());
+        resendExpression();
     });
 
     sendIdentityReply(_usb.midi());
 
-    sendExpression(_exp.getValue());
+    resendExpression();
+
+    const uint32_t now = micros();
+    _scheduler.every(Expression::kPeriodUs, [this] { _exp.run(); }, now);
+    _scheduler.every(kDisplayPeriodUs, [this] { runDisplay(); }, now);
+    _scheduler.every(kLinkPeriodUs, [this] { _network.checkLink(); }, now);
+    _scheduler.every(kStoragePeriodUs, [] { Storage::run(); }, now);
+    _scheduler.every(LedEffects::kTickUs, [this] { _effects.tick(millis()); }, now);
 }
 
 void Controller::sendIdentityReply(MidiSender& sender)
@@ -78,30 +89,60 @@ void Controller::sendIdentityReply(MidiSender& sender)
     sender.sendSysEx(reply);
 }
 
+// One pass over whatever may have work: interrupt fed sources every time,
+// the rest when the scheduler says they're due. main() then sleeps until
+// deadline() or the next interrupt.
 void Controller::run() 
 {    
     _usb.run();
     _buttons.run();
-    _exp.run();
+    for (auto ticks = midi_clock_ticks(); ticks > 0; --ticks)
+    {
+        clockTick();
+    }
+    _scheduler.run(micros());
+    _midi_out.run(micros());
     _network.run();
     _leds.run();
 
-    if (_display_timer.expired())
+    // Rate limited work that's still pending needs a pass before the next
+    // task would give it one. A pending LED frame doesn't: the latch alarm
+    // that frees the LEDs wakes the loop.
+    const uint32_t now = micros();
+    uint32_t flush;
+    if (_midi_out.nextFlush(flush))
+    {
+        _scheduler.wakeBy(flush);
+    }
+    if (_buttons.pending() || _usb.config().busy())
+    {
+        _scheduler.wakeBy(now + kPendingPeriodUs);
+    }
+
+    // Last, so a program change has already gone out when its neighbours
+    // are read. One program per pass keeps each pass short.
+    if (_prefetch)
     {
-        static uint32_t display_runs = 0;
-        static uint32_t total_time = 0;
-        auto start = millis();
-         _display.run();
-        total_time += millis() - start;
-        if (++display_runs >= 30) {  // ~1s at 30 Hz
-            printf("display average: %u\n", (total_time * 1000) / display_runs);
-            total_time = 0;
-            display_runs = 0;
+        prefetch();
+        if (_prefetch)
+        {
+            _scheduler.wakeBy(now + kPendingPeriodUs);
         }
-        _display_timer.restart(33333);  // 33333us interval = exact 30 Hz
     }
 }
 
+void Controller::runDisplay()
+{
+    // Input first: while switch changes are being held for the detection
+    // delay, the frame waits for the next tick. The display keeps its own
+    // frame costs (see getDiagnostics).
+    if (_buttons.pending())
+    {
+        return;
+    }
+    _display.run();
+}
+
 void Controller::footswitchCallback(Switches::Mask status, Switches::Mask modified)
 {
     auto activated = status & modified;
@@ -190,118 +231,117 @@ void Controller::programCallback(Switches::Mask status, Switches::Mask modified)
 
 void Controller::midiCallback(std::span<const uint8_t> packet, std::span<uint8_t> buffer, MidiSender& sender)
 {
+    // MidiParser hands out exactly one complete message per call; realtime
+    // bytes (clock and friends) are of no interest here
+    if (packet[0] >= 0xF8) {
+        return;
+    }
+
     uint8_t channel = _config.midi().channel();
-    while (!packet.empty()) {
-        uint8_t msg_channel = packet[0] & 0x0F;
-        uint8_t msg_type = packet[0] & 0xF0;
-        if (msg_channel == channel && msg_type == 0xC0) {
-            // The value is an absolute program id. A program outside the active
-            // setlist switches the pedal to the "All" setlist (which holds every
-            // program) instead of being dropped.
-            uint8_t value = packet[1];
-            int16_t pos = _setlist.find(value);
-            if (pos < 0) {
-                selectSetlist(kAllSetlist);
-                pos = _setlist.find(value);
-            }
-            if (pos < 0) {
-                // Still not a valid program id: leave the pedal exactly as it is.
-            } else if (_tuner_mode) {
-                Program target;
-                target.load(value);
-                _saved_program_id = value;
-                _saved_setlist_pos = uint8_t(pos);
-                defaultSwitchesState(target, _saved_switches_state);
-                _restore_state = true;
-            } else {
-                footswitchMode(false);
-                loadPosition(uint8_t(pos), false, true);
-            }
-        } else if (msg_channel == channel && msg_type == 0xB0 && packet[1] == 32) {
-            // Setlist select: 0 is "All", 1..kMaxSetlists the stored setlists.
-            // Unknown, empty or already-active values are ignored.
-            if (selectSetlist(packet[2])) {
-                if (_tuner_mode) {
-                    Program target;
-                    target.load(_saved_program_id);
-                    defaultSwitchesState(target, _saved_switches_state);
-                    _restore_state = true;
-                } else {
-                    footswitchMode(false);
-                    loadPosition(_setlist_pos, false, true);
-                }
-            }
-        } else if (msg_channel == channel && msg_type == 0xB0 && packet[1] == 43) {
+    uint8_t msg_channel = packet[0] & 0x0F;
+    uint8_t msg_type = packet[0] & 0xF0;
+    if (msg_channel == channel && msg_type == 0xC0) {
+        // The value is an absolute program id. A program outside the active
+        // setlist switches the pedal to the "All" setlist (which holds every
+        // program) instead of being dropped. Both lookups are constant time:
+        // DAWs fire bursts of these on every song change.
+        uint8_t value = packet[1];
+        int16_t pos = _setlist.find(value);
+        if (pos < 0 && value < Program::kMaxPrograms) {
+            selectSetlist(kAllSetlist);
+            pos = _setlist.find(value);
+        }
+        if (pos < 0) {
+            // Still not a valid program id: leave the pedal exactly as it is.
+        } else if (_tuner_mode) {
+            Program target;
+            target.load(value);
+            _saved_program_id = value;
+            _saved_setlist_pos = uint8_t(pos);
+            defaultSwitchesState(target, _saved_switches_state);
+            _restore_state = true;
+        } else {
+            footswitchMode(false);
+            loadPosition(uint8_t(pos), false, true);
+        }
+    } else if (msg_channel == channel && msg_type == 0xB0 && packet[1] == 32) {
+        // Setlist select: 0 is "All", 1..kMaxSetlists the stored setlists.
+        // Unknown, empty or already-active values are ignored.
+        if (selectSetlist(packet[2])) {
             if (_tuner_mode) {
-                // _saved_program_id already reflects whatever program is pending for
-                // exit (the live one, or a program deferred by an earlier PC while
-                // tuning) -- only the scene within that program changes here, so the
-                // saved stomp toggles are preserved.
                 Program target;
                 target.load(_saved_program_id);
-                applySceneToState(target, _saved_switches_state, packet[2]);
+                defaultSwitchesState(target, _saved_switches_state);
                 _restore_state = true;
             } else {
                 footswitchMode(false);
-                changeSwitch(packet[2], true, false);
-                changeSwitch(packet[2], false, false);
-                sleep_ms(1);
-                _leds.refresh();
+                loadPosition(_setlist_pos, false, true);
             }
-        } else if (msg_channel == channel && msg_type == 0xB0 &&
-                   packet[1] >= 35 && packet[1] <= 42) {
-            uint8_t switch_id = packet[1] - 35;  // CC 35..42 -> switch 0..7
-            bool enable = packet[2] >= 64;       // 0..63 off, 64..127 on
-            if (_tuner_mode) {
-                // Defer to the saved state applied on tuner exit, like CC 43.
-                Program target;
-                target.load(_saved_program_id);
-                if (stompLike(target, switch_id)) {
-                    _saved_switches_state[switch_id] = enable;
-                    _restore_state = true;
-                }
-            } else {
-                setSwitchEnabled(switch_id, enable);
-            }
-        } else if (msg_channel == channel && msg_type == 0xB0 && packet[1] == kTunerModeCc) {
-            uint8_t value = packet[2];
-            if (value > 0 && !_tuner_mode) {
-                tunerMode();
-            } else if (value == 0 && _tuner_mode) {
-                exitTunerMode(false);
-            }
-        } else if (msg_channel == channel && msg_type == 0x90) {
-            int8_t velocity = packet[2];
-            uint8_t note = packet[1];
-            if (velocity > 63) {
-                ++note;
-                velocity -= 128;
-            }
-            displayTuner(note, velocity);
-        } else if (msg_channel == channel && msg_type == 0x80 && packet[1] == 0) {
-            displayTuner(0, 0);
-        } else if (packet[0] == 0xF0) {
-            // MIDI Universal Non-Realtime Identity Request: F0 7E <id> 06 01 F7
-            if (packet.size() == 6 &&
-                packet[1] == 0x7E &&
-                (packet[2] == 0x7F || packet[2] == channel) &&
-                packet[3] == 0x06 && packet[4] == 0x01 &&
-                packet[5] == 0xF7)
-            {
-                sendIdentityReply(sender);
-                return;
-            }
-            auto response = _usb.config().processSysEx(packet, buffer, channel);
-            if (response.size() > 0) {
-                sender.sendSysEx(response);
+        }
+    } else if (msg_channel == channel && msg_type == 0xB0 && packet[1] == 43) {
+        if (_tuner_mode) {
+            // _saved_program_id already reflects whatever program is pending for
+            // exit (the live one, or a program deferred by an earlier PC while
+            // tuning) -- only the scene within that program changes here, so the
+            // saved stomp toggles are preserved.
+            Program target;
+            target.load(_saved_program_id);
+            applySceneToState(target, _saved_switches_state, packet[2]);
+            _restore_state = true;
+        } else {
+            footswitchMode(false);
+            changeSwitch(packet[2], true, false);
+            changeSwitch(packet[2], false, false);
+            sleep_ms(1);
+            _leds.refresh();
+        }
+    } else if (msg_channel == channel && msg_type == 0xB0 &&
+               packet[1] >= 35 && packet[1] <= 42) {
+        uint8_t switch_id = packet[1] - 35;  // CC 35..42 -> switch 0..7
+        bool enable = packet[2] >= 64;       // 0..63 off, 64..127 on
+        if (_tuner_mode) {
+            // Defer to the saved state applied on tuner exit, like CC 43.
+            Program target;
+            target.load(_saved_program_id);
+            if (stompLike(target, switch_id)) {
+                _saved_switches_state[switch_id] = enable;
+                _restore_state = true;
             }
+        } else {
+            setSwitchEnabled(switch_id, enable);
         }
-
-        size_t next = 1;
-        while (next < packet.size() && !(packet[next] & 0x80)) {
-            ++next;
+    } else if (msg_channel == channel && msg_type == 0xB0 && packet[1] == kTunerModeCc) {
+        uint8_t value = packet[2];
+        if (value > 0 && !_tuner_mode) {
+            tunerMode();
+        } else if (value == 0 && _tuner_mode) {
+            exitTunerMode(false);
+        }
+    } else if (msg_channel == channel && msg_type == 0x90) {
+        int8_t velocity = packet[2];
+        uint8_t note = packet[1];
+        if (velocity > 63) {
+            ++note;
+            velocity -= 128;
+        }
+        displayTuner(note, velocity);
+    } else if (msg_channel == channel && msg_type == 0x80 && packet[1] == 0) {
+        displayTuner(0, 0);
+    } else if (packet[0] == 0xF0) {
+        // MIDI Universal Non-Realtime Identity Request: F0 7E <id> 06 01 F7
+        if (packet.size() == 6 &&
+            packet[1] == 0x7E &&
+            (packet[2] == 0x7F || packet[2] == channel) &&
+            packet[3] == 0x06 && packet[4] == 0x01 &&
+            packet[5] == 0xF7)
+        {
+            sendIdentityReply(sender);
+            return;
+        }
+        auto response = _usb.config().processSysEx(packet, buffer, channel, sender);
+        if (response.size() > 0) {
+            sender.sendSysEx(response);
         }
-        packet = packet.subspan(next);
     }
 }
 
@@ -329,8 +369,7 @@ void Controller::setupCallback(Switches::Mask status, Switches::Mask modified)
         if (_pendingChannel != _config.midi().channel()) {
             _config.midi().setChannel(_pendingChannel);
             _network.reinitMidi(_pendingChannel);
-            sendIdentityReply(_usb.midi());
-            sendIdentityReply(_network.midi());
+            sendIdentityReply(_midi_out);
         }
         _config.expression().setMinRaw(_exp.getMinRaw());
         _config.expression().setMaxRaw(_exp.getMaxRaw());
@@ -389,6 +428,7 @@ void Controller::setupMode()
     _switches_state.reset();
     _buttons.setCallback(std::bind(&Controller::setupCallback, this, _1, _2));
     _exp.setCallback(std::bind(&Controller::setExpValue, this, _1));
+    _exp.setFineCallback(nullptr);
 }
 
 void Controller::changeProgramMode()
@@ -438,6 +478,7 @@ bool Controller::selectSetlist(uint8_t setlist_id)
     _restore_state = false;
     _saved_setlist_pos = _setlist_pos;
     _saved_program_id = _setlist.program(_setlist_pos);
+    _prefetch = true;
 
     return true;
 }
@@ -496,6 +537,7 @@ void Controller::setlistMode()
     _display.setFootswitch(kExitProgramSwitch, "EXIT");
     displaySetlistSelection();
 
+    _effects.stopAll();
     for (uint8_t lid = 0; lid < _leds.kNumLeds; ++lid)
     {
         _leds.setColor(lid, kWhite, false);
@@ -506,6 +548,7 @@ void Controller::setlistMode()
     _buttons.setCallback(std::bind(&Controller::setlistCallback, this, _1, _2));
     // Browsing must not repaint the header with the expression readout.
     _exp.setCallback(nullptr);
+    _exp.setFineCallback(nullptr);
 }
 
 void Controller::setlistCallback(Switches::Mask status, Switches::Mask modified)
@@ -548,6 +591,7 @@ void Controller::setlistCallback(Switches::Mask status, Switches::Mask modified)
 
 void Controller::tunerMode() {
     _tuner_mode = true;
+    _tap_sw_id = Program::kInvalidId;  // the LEDs show the tuner now
     // Only capture the live state when there isn't already a pending restore.
     // When tuner is entered from the change-program menu, _restore_state is
     // already set and _saved_* hold the real live program/switch state (captured
@@ -574,8 +618,7 @@ void Controller::tunerMode() {
     });
 
     auto channel = _config.midi().channel();
-    _network.midi().sendControl(channel, kTunerModeCc, 127);
-    _usb.midi().sendControl(channel, kTunerModeCc, 127);
+    _midi_out.sendControl(channel, kTunerModeCc, 127);
 }
 
 // Reports the active setlist, in the same encoding an incoming CC 32 uses: 0 for
@@ -584,8 +627,7 @@ void Controller::tunerMode() {
 void Controller::sendSetlist()
 {
     auto channel = _config.midi().channel();
-    _network.midi().sendControl(channel, 32, _setlist_id);
-    _usb.midi().sendControl(channel, 32, _setlist_id);
+    _midi_out.sendControl(channel, 32, _setlist_id);
 }
 
 void Controller::exitTunerMode(bool send_midi)
@@ -593,8 +635,7 @@ void Controller::exitTunerMode(bool send_midi)
     _tuner_mode = false;
     if (send_midi) {
         auto channel = _config.midi().channel();
-        _network.midi().sendControl(channel, kTunerModeCc, 0);
-        _usb.midi().sendControl(channel, kTunerModeCc, 0);
+        _midi_out.sendControl(channel, kTunerModeCc, 0);
     }
     footswitchMode(false);
 }
@@ -604,8 +645,7 @@ void Controller::factoryReset()
     for (uint8_t led = 0; led < _leds.kNumLeds; ++led) {
         _leds.setColor(led, kRed, true);
     }
-    _leds.refresh(true);
-    _leds.run();
+    _leds.flush();
     _display.showMessage("Factory reset");
     Storage::factoryReset();
     _config.load();
@@ -634,6 +674,7 @@ void Controller::footswitchMode(bool send_midi)
     // resets the delay to off.
     _buttons.setDetectionDelay(_program_sw_id == Program::kInvalidId);
     _exp.setCallback(std::bind(&Controller::sendExpression, this, _1));
+    _exp.setFineCallback(std::bind(&Controller::sendFineExpression, this, _1));
 }
 
 void Controller::displayTuner(uint8_t note, int64_t cents)
@@ -642,49 +683,7 @@ void Controller::displayTuner(uint8_t note, int64_t cents)
         return;
     }
     _display.setTuner(true, note, cents);
-
-    // Full-scale tuning offset.
-    static constexpr int kMinCents = -64;
-    static constexpr int kMaxCents = 63;
-
-    const uint8_t columns = _leds.kNumLeds / 2;  // 4 (long) or 3 (short)
-    struct RGB { uint8_t r, g, b; };
-    RGB col[4] = {};  // per-column color; up to 4 columns
-
-    // Wider dead zone: the middle column(s) show solid green here.
-    const bool in_tune = (cents >= -4 && cents <= 3);
-
-    if (note < 24) {
-        // No valid note: leave everything off.
-    } else if (in_tune) {
-        if (columns >= 4) {
-            col[1] = col[2] = {0, kLedMax, 0};
-        } else {
-            col[1] = {0, kLedMax, 0};
-        }
-    } else {
-        // Continuous moving bar: map cents to a position across the column
-        // index range and split intensity between the two nearest columns
-        // with a triangular falloff. Integer math, scaled by D = range size.
-        const int c = std::min(std::max(static_cast<int>(cents), kMinCents), kMaxCents);
-        const int D = kMaxCents - kMinCents;  // 127
-        const int N = columns - 1;
-        for (uint8_t i = 0; i < columns; ++i) {
-            const int diff = (c - kMinCents) * N - static_cast<int>(i) * D;
-            const int adiff = diff < 0 ? -diff : diff;
-            const int level = kLedMax - (kLedMax * adiff + D / 2) / D;
-            if (level > 0) {
-                col[i] = {_gamma_table[level], 0, 0};
-            }
-        }
-    }
-
-    for (uint8_t i = 0; i < _leds.kNumLeds; ++i)
-    {
-        const RGB& c = col[i % columns];
-        _leds.setColor(i, c.r, c.g, c.b);
-    }
-    _leds.refresh();
+    _effects.meter(note, static_cast<int>(std::clamp<int64_t>(cents, INT16_MIN, INT16_MAX)));
 }
 
 void Controller::changeSwitch(uint8_t id, bool active, bool send_midi)
@@ -699,6 +698,16 @@ void Controller::changeSwitch(uint8_t id, bool active, bool send_midi)
     {
         return;  // pure trigger, handled in footswitchCallback; never toggles state
     }
+    if (sw_mode == Program::Footswitch::kTapTempo)
+    {
+        // Only physical presses tap: their edge time is what the tempo is
+        // measured from. Never toggles state either.
+        if (active && send_midi)
+        {
+            tapTempo(id);
+        }
+        return;
+    }
 
     const auto& fs = _program.footswitch(id);
     bool is_scene = (sw_mode == Program::Footswitch::kScene);
@@ -720,8 +729,7 @@ void Controller::changeSwitch(uint8_t id, bool active, bool send_midi)
             _switches_state[_fs_id] = false;
             _leds.setColor(_fs_id, prev.color(), false);
             if (send_midi) {
-                prev.run(_network.midi(), false, _config.midi().channel());
-                prev.run(_usb.midi(), false, _config.midi().channel());
+                prev.run(_midi_out, false, _config.midi().channel());
             }
         }
         _switches_state[id] = true;
@@ -731,12 +739,44 @@ void Controller::changeSwitch(uint8_t id, bool active, bool send_midi)
     }
 
     if (send_midi) {
-        fs.run(_network.midi(), _switches_state[id], _config.midi().channel());
-        fs.run(_usb.midi(), _switches_state[id], _config.midi().channel());
+        fs.run(_midi_out, _switches_state[id], _config.midi().channel());
     }
     _leds.setColor(id, fs.color(), _switches_state[id]);
 }
 
+void Controller::tapTempo(uint8_t id)
+{
+    const auto& fs = _program.footswitch(id);
+    if (!fs.available())
+    {
+        return;
+    }
+    fs.run(_midi_out, true, _config.midi().channel());
+    if (_tap_tempo.tap(_buttons.eventTime()))
+    {
+        _clock_quarter_us = _tap_tempo.interval();
+        midi_clock_start(_clock_quarter_us);
+        _clock_tick = 0;
+    }
+}
+
+// USB already has this tick from the HAL; the router takes it to Ethernet
+void Controller::clockTick()
+{
+    static constexpr uint8_t kClock[] = {0xF8};
+    _midi_out.sendMessage(kClock);
+
+    // The tap switch's LED is lit for the first sixteenth of every beat.
+    // The blink keeps the time; each beat only re-phases it to the clock.
+    if (_tap_sw_id != Program::kInvalidId && _clock_tick == 0)
+    {
+        const auto color = _program.footswitch(_tap_sw_id).color();
+        _effects.blink(_tap_sw_id, Leds::rgb(color, true), Leds::rgb(color, false),
+                       _clock_quarter_us / 1000, _clock_quarter_us / 4000);
+    }
+    _clock_tick = (_clock_tick + 1) % kMidiClockPpq;
+}
+
 bool Controller::stompLike(const Program& program, uint8_t id) const
 {
     if (id >= program.numFootswitches()) { return false; }
@@ -760,10 +800,33 @@ void Controller::setSwitchEnabled(uint8_t id, bool enable)
 void Controller::sendExpression(uint8_t value)
 {
     if (value == Expression::kDisconnected) { return; } // nothing to send
-    if (_program.available() && _program.expressionEnabled())
+    if (_program.available() && _program.expressionEnabled() && !_program.expressionHighRes())
     {
-        _program.sendExpression(_network.midi(), value, _config.midi().channel());
-        _program.sendExpression(_usb.midi(), value, _config.midi().channel());
+        _program.sendExpression(_midi_out.latest(), value, _config.midi().channel());
+    }
+}
+
+void Controller::sendFineExpression(uint16_t value)
+{
+    if (_exp.getValue() == Expression::kDisconnected) { return; }
+    if (_program.available() && _program.expressionHighRes())
+    {
+        _program.sendFineExpression(_midi_out.latest(), value, _exp_fine_sent, _config.midi().channel());
+        _exp_fine_sent = value;
+    }
+}
+
+// The current position in full, for a newly loaded program or a new link
+void Controller::resendExpression()
+{
+    if (_program.expressionHighRes())
+    {
+        _exp_fine_sent = Program::kNoFineValue;
+        sendFineExpression(_exp.getFineValue());
+    }
+    else
+    {
+        sendExpression(_exp.getValue());
     }
 }
 
@@ -778,10 +841,36 @@ void Controller::configChanged()
     _network.reinitMidi(_config.midi().channel());
 }
 
+void Controller::getDiagnostics(ConfigProtocol::Diagnostics& diagnostics)
+{
+    const auto stats = _display.takeStats();
+    diagnostics.uptime_ms = millis();
+    diagnostics.frame_budget_us = _display.frameBudget();
+    diagnostics.frame_last_us = stats.last_us;
+    diagnostics.frame_max_us = stats.max_us;
+    diagnostics.frame_avg_us = stats.rendered ? stats.total_us / stats.rendered : 0;
+    diagnostics.frames_rendered = stats.rendered;
+    diagnostics.frames_skipped = stats.skipped;
+    diagnostics.frame_divider = _display.frameDivider();
+    const auto clock = midi_clock_take_stats();
+    diagnostics.clock_late_max_us = clock.late_max_us;
+    diagnostics.clock_ticks = clock.ticks;
+    diagnostics.clock_deferred = clock.deferred;
+}
+
 void Controller::programChanged(uint8_t id)
 {
+    for (auto& entry : _prefetched)
+    {
+        if (entry.id == id)
+        {
+            entry.id = Program::kInvalidId;
+            _prefetch = true;
+        }
+    }
     if (id == _program_id)
     {
+        _program_loaded = false;
         loadProgram(id, false, true);
     }
 }
@@ -798,7 +887,8 @@ void Controller::defaultSwitchesState(const Program& program, std::bitset<Progra
             continue;
         }
         bool is_scene = (program.switchMode(id) == Program::Footswitch::kScene);
-        bool is_program_sw = (program.switchMode(id) == Program::Footswitch::kProgram);
+        bool is_program_sw = (program.switchMode(id) == Program::Footswitch::kProgram ||
+                              program.switchMode(id) == Program::Footswitch::kTapTempo);
         state[id] = is_scene ? (id == scene) : (is_program_sw ? false : fs.enabled());
     }
 }
@@ -825,20 +915,27 @@ void Controller::loadProgram(uint8_t id, bool send_midi, bool display_switches,
         _program.switchMode(_fs_id) == Program::Footswitch::kScene &&
         _switches_state[_fs_id])
     {
-        _program.footswitch(_fs_id).run(_usb.midi(), false, _config.midi().channel());
-        _program.footswitch(_fs_id).run(_network.midi(), false, _config.midi().channel());
+        _program.footswitch(_fs_id).run(_midi_out, false, _config.midi().channel());
     }
+    const uint8_t previous_id = _program_id;
     _program_id = id;
     _fs_id = 0;
-    _program.load(id);
+    // Mode changes reload the live program all the time; it only goes back
+    // to flash when the editor changed it
+    const bool loaded = _program_loaded && id == previous_id;
+    if (!loaded && !(_program_loaded && takePrefetched(id, previous_id)))
+    {
+        _program.load(id);
+    }
+    _program_loaded = true;
+    _prefetch = true;
 
     displayProgram(display_switches);
 
     if (send_midi && _program.available())
     {
-        _program.run(_usb.midi(), _config.midi().channel());
-        _program.run(_network.midi(), _config.midi().channel());
-        sendExpression(_exp.getValue());
+        _program.run(_midi_out, _config.midi().channel());
+        resendExpression();
     }
 
     if (display_switches)
@@ -881,6 +978,25 @@ void Controller::loadProgram(uint8_t id, bool send_midi, bool display_switches,
         }
     }
 
+    // The tap switch blinks at tempo, but only while the switches are shown.
+    // The clock keeps running while browsing and only stops once a program
+    // without a tap switch is live.
+    _tap_sw_id = Program::kInvalidId;
+    for (uint8_t sid = 0; display_switches && sid < _program.numFootswitches(); ++sid)
+    {
+        if (_program.switchMode(sid) == Program::Footswitch::kTapTempo && _program.footswitch(sid).available())
+        {
+            _tap_sw_id = sid;
+            break;
+        }
+    }
+    if (display_switches && _tap_sw_id == Program::kInvalidId)
+    {
+        midi_clock_stop();
+        _tap_tempo.reset();
+    }
+
+    _effects.stopAll();
     for (uint8_t lid = 0; lid < _leds.kNumLeds; ++lid)
     {
         if (!display_switches)
@@ -918,6 +1034,52 @@ void Controller::movePosition(int8_t delta)
     loadPosition(uint8_t((_setlist_pos + num + step) % num), false, false);
 }
 
+// Swaps a prefetched program in, in place: the display holds pointers into
+// _program. The outgoing program takes its slot, which is where the way back
+// will look for it.
+bool Controller::takePrefetched(uint8_t id, uint8_t previous_id)
+{
+    for (auto& entry : _prefetched)
+    {
+        if (entry.id == id)
+        {
+            std::swap(_program, entry.program);
+            entry.id = previous_id;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Controller::prefetch()
+{
+    const int num = _setlist.numPrograms();
+    const uint8_t ids[] = {
+        _setlist.program(uint8_t((_setlist_pos + num - 1) % num)),
+        _setlist.program(uint8_t((_setlist_pos + 1) % num)),
+    };
+
+    // A step moves one neighbour into the other's slot
+    if ((_prefetched[0].id != ids[0] && _prefetched[1].id == ids[0]) ||
+        (_prefetched[1].id != ids[1] && _prefetched[0].id == ids[1]))
+    {
+        std::swap(_prefetched[0], _prefetched[1]);
+    }
+    for (uint8_t slot = 0; slot < std::size(ids); ++slot)
+    {
+        auto& entry = _prefetched[slot];
+        if (entry.id == ids[slot] || ids[slot] == _program_id)
+        {
+            continue;
+        }
+        entry.program.load(ids[slot]);
+        entry.id = ids[slot];
+        // The other one on the next pass
+        return;
+    }
+    _prefetch = false;
+}
+
 void Controller::displayProgram(bool display_switches) {
     _display.setNumber(_setlist_pos + 1);
     _display.setText(_program.available() ? _program.name() : "<EMPTY>");
@@ -3,14 +3,16 @@
 #include "switches.h"
 #include "expression.h"
 #include "leds.h"
+#include "led_effects.h"
 #include "usb_device.h"
 #include "display.h"
 #include "config.h"
 #include "network.h"
+#include "midi_router.h"
+#include "tap_tempo.h"
 #include "hal.h"
 #include "poll_timer.h"
-
-#include <cmath>
+#include "scheduler.h"
 
 #define CHANNEL_PREFIX "CH "
 #define CHANNEL_TEXT CHANNEL_PREFIX "16"
@@ -31,15 +33,11 @@ public:
         _display(config.displayI2C, config.displaySPI, _switches_state),
         _network(config.ethernet)
     {
-        // Gamma-correct (gamma = 2.2) lookup table: _gamma_table[level] is the
-        // duty cycle that looks as bright to the eye as a linear ramp at
-        // `level`, computed once here so displayTuner() avoids a runtime pow().
-        for (int level = 0; level <= kLedMax; ++level) {
-            _gamma_table[level] = static_cast<uint8_t>(kLedMax * std::pow(static_cast<float>(level) / kLedMax, 2.2f) + 0.5f);
-        }
     }
     void init();
     void run();
+    // micros() time by which run() has to be called again
+    uint32_t deadline() const { return _scheduler.deadline(micros()); }
 
 private:
     void footswitchCallback(Switches::Mask status, Switches::Mask modified);
@@ -50,6 +48,7 @@ private:
 
     void configChanged() override;
     void programChanged(uint8_t id) override;
+    void getDiagnostics(ConfigProtocol::Diagnostics& diagnostics) override;
 
     void sendIdentityReply(MidiSender& sender);
     void factoryReset();
@@ -62,9 +61,14 @@ private:
     void tunerMode();
     void exitTunerMode(bool send_midi);
     void changeSwitch(uint8_t id, bool active, bool send_midi);
+    void runDisplay();
+    void tapTempo(uint8_t id);
+    void clockTick();
     bool stompLike(const Program& program, uint8_t id) const;
     void setSwitchEnabled(uint8_t id, bool enable);
     void sendExpression(uint8_t value);
+    void sendFineExpression(uint16_t value);
+    void resendExpression();
     void sendSetlist();
     void updateProgram(uint8_t id);
     void updateConfig();
@@ -73,6 +77,8 @@ private:
     void loadPosition(uint8_t pos, bool send_midi, bool display_switches,
                       const std::bitset<Program::kNumSwitches>* restore_state = nullptr);
     void movePosition(int8_t delta);
+    bool takePrefetched(uint8_t id, uint8_t previous_id);
+    void prefetch();
     void defaultSwitchesState(const Program& program, std::bitset<Program::kNumSwitches>& state) const;
     void applySceneToState(const Program& program, std::bitset<Program::kNumSwitches>& state, uint8_t scene_id) const;
     void displayProgram(bool display_switches);
@@ -85,21 +91,43 @@ private:
     const uint8_t* _sw_map;
     Expression _exp;
     Leds _leds;
+    LedEffects _effects{_leds};
     Display _display;
     Network _network;
+    // Every outgoing message goes through here, once, to both transports
+    MidiRouter _midi_out;
+    // Max expression updates per second and transport: each UDP datagram is
+    // a full W6100 send, so the network gets fewer than USB
+    static constexpr uint32_t kUsbControlRate = 1000;
+    static constexpr uint32_t kNetworkControlRate = 200;
     Config _config{};
     Program _program{};
     // The active setlist drives program-change navigation. It defaults to the
     // synthetic "All" setlist (every program, in order), which reproduces the
     // pre-setlist behavior exactly, and is not persisted across reboots.
-    Setlist _setlist{};
+    IndexedSetlist _setlist{};
     static constexpr uint8_t kAllSetlist = 0;   // cursor value for "All"
     uint8_t _setlist_id = kAllSetlist;          // 0 = All, 1..26 = Setlist id 0..25
     uint8_t _setlist_pos = 0;                   // cursor within _setlist
     uint8_t _program_id = 0;
+    // The programs either side of the setlist position, decoded ahead of time
+    // so stepping through a setlist during a show never waits on flash. Slot
+    // 0 is the previous position, slot 1 the next.
+    struct Prefetched
+    {
+        uint8_t id = Program::kInvalidId;
+        Program program{};
+    };
+    Prefetched _prefetched[2]{};
+    bool _prefetch = false;                         // neighbours need a refresh
+    bool _program_loaded = false;                   // _program holds _program_id
     uint8_t _fs_id = 0;
     uint8_t _program_sw_id = Program::kInvalidId;  // cached id of the kProgram switch for
                                                     // the current program, or kInvalidId
+    uint8_t _tap_sw_id = Program::kInvalidId;      // kTapTempo switch whose LED blinks
+    TapTempo _tap_tempo{};
+    uint8_t _clock_tick = 0;                        // MIDI clock tick within the beat
+    uint32_t _clock_quarter_us = 0;                 // the running clock's tempo
     uint8_t _saved_program_id = 0;
     uint8_t _saved_setlist_pos = 0;
     // Setlist menu: the ids that are actually selectable, rebuilt on entry so
@@ -115,11 +143,10 @@ private:
     uint8_t _counter = 0;
     std::bitset<Program::kNumSwitches> _switches_state{};
     char _expValue[sizeof(EXP_VALUE_TEXT)]{EXP_VALUE_TEXT};
+    uint16_t _exp_fine_sent = Program::kNoFineValue;  // last 14 bit value sent
     bool _tuner_mode = false;
     uint8_t _pendingChannel = 0;
 
-    static constexpr int kLedMax = 128;  // max LED intensity, also used by displayTuner()
-    uint8_t _gamma_table[kLedMax + 1] = {};
 
     static constexpr uint8_t kIncOneSwitch = 0;
     static constexpr uint8_t kIncTenSwitch = 1;
@@ -142,7 +169,13 @@ private:
     const uint8_t kDecChannelSwitch = uint8_t(_leds.kNumLeds - 2);
     const uint8_t kExitSwitch = uint8_t(_leds.kNumLeds - 1);
 
-    PollTimer _display_timer{};
+    Scheduler _scheduler{};
+    static constexpr uint32_t kDisplayPeriodUs = 33333;   // exact 30 Hz
+    // A quarter of a frame period: the switches mustn't wait longer on a frame
+    static constexpr uint32_t kDisplayBudgetUs = kDisplayPeriodUs / 4;
+    static constexpr uint32_t kLinkPeriodUs = 100000;
+    static constexpr uint32_t kStoragePeriodUs = 10000;   // incremental garbage collection
+    static constexpr uint32_t kPendingPeriodUs = 1000;
 };
 
 }
@@ -2,7 +2,9 @@
 
 #include <u8x8.h>
 
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
 #include <cassert>
 
 #define STR_HELPER(x) #x
@@ -150,6 +152,7 @@ void Display::init()
 		u8g2_SetUserPtr(&_u8g2, &_i2c);
 	}
 	_u8g2_buffer.resize(u8g2_GetBufferSize(&_u8g2));
+	_labels_layer.resize(_u8g2_buffer.size());
 	u8g2_SetBufferPtr(&_u8g2, _u8g2_buffer.data());
 	u8g2_SetI2CAddress(&_u8g2, 0x78);
 	u8g2_InitDisplay(&_u8g2); // send init sequence to the display, display is in sleep mode after this,
@@ -189,6 +192,8 @@ void Display::setText(const char* text)
 	_scroll.pixel = 0;
 	_scroll.size = text ? strlen(_scroll.text) : 0;
 	_scroll.delay = 10;
+	_name_changed = true;
+	_dirty = true;
 }
 
 void Display::setBlink(bool enabled)
@@ -196,12 +201,14 @@ void Display::setBlink(bool enabled)
 	_blink.ticks = enabled ? kBlinkTicks : 0;
 	_blink.enabled = enabled;
 	_blink.state = true;
+	_dirty = true;
 }
 
 void Display::setTuner(bool enabled, uint8_t note, int8_t cents)
 {
 	_tuner.enabled = enabled;
 	if (!enabled) {
+		_dirty = true;
 		return;
 	}
 
@@ -278,8 +285,63 @@ void Display::drawTuner()
 
 void Display::run()
 {
-  if (_dirty || _tuner.enabled || _blink.enabled) {
-	u8g2_ClearBuffer(&_u8g2);
+	if (_frame.elapsed < UINT8_MAX)
+	{
+		++_frame.elapsed;
+	}
+	const bool changed = _dirty || _fs_state != _frame.fs_state;
+	if (!changed && (!animating() || _frame.elapsed < _frame.divider))
+	{
+		// Nothing new on screen, or an animation frame given up for the budget
+		_frame.stats.skipped += animating();
+		return;
+	}
+
+	const uint32_t start = micros();
+	render(_frame.elapsed);
+	const uint32_t cost = micros() - start;
+
+	_dirty = false;
+	_frame.elapsed = 0;
+	_frame.fs_state = _fs_state;
+	auto& stats = _frame.stats;
+	stats.last_us = cost;
+	stats.max_us = std::max(stats.max_us, cost);
+	stats.total_us += cost;
+	++stats.rendered;
+	adaptRate(cost);
+}
+
+Display::FrameStats Display::takeStats()
+{
+	const FrameStats stats = _frame.stats;
+	_frame.stats = {.last_us = stats.last_us};
+	return stats;
+}
+
+void Display::adaptRate(uint32_t cost_us)
+{
+	if (cost_us > _frame.budget_us)
+	{
+		_frame.divider = std::min<uint8_t>(_frame.divider * 2, kMaxFrameDivider);
+		_frame.within = 0;
+	}
+	else if (cost_us > _frame.budget_us / 2 || _frame.divider == 1)
+	{
+		_frame.within = 0;
+	}
+	else if (++_frame.within == kRecoverFrames)
+	{
+		_frame.divider /= 2;
+		_frame.within = 0;
+	}
+}
+
+// `elapsed` ticks have gone by since the previous frame
+void Display::render(uint8_t elapsed)
+{
+  // A switch turning on or off alone only needs the footswitches redrawn
+  if (_dirty || animating()) {
 	u8g2_SetFontRefHeightExtendedText(&_u8g2);
 	u8g2_SetFontPosTop(&_u8g2);
 	u8g2_SetFontDirection(&_u8g2, 0);
@@ -291,22 +353,34 @@ void Display::run()
 	{
 		// Tuner takes over the whole screen; the footswitch labels (opaque font)
 		// would otherwise bleed through the gaps between the tuner's tick lines.
+		u8g2_ClearBuffer(&_u8g2);
 		drawTuner();
 	}
 	else
 	{
-		for (uint8_t i = 0; i < Program::kNumSwitches; ++i)
+		// Both render through the u8g2 buffer, which is redrawn below anyway
+		if (_name_changed)
+		{
+			renderName();
+		}
+		if (_labels_changed)
 		{
-			drawFootswitch(i, _fs_text[i]);
+			renderLabels();
 		}
+		std::copy(_labels_layer.begin(), _labels_layer.end(), _u8g2_buffer.begin());
 
 		if (_blink.enabled)
 		{
-			if (--_blink.ticks == 0)
+			// Counts ticks rather than frames, so dropped frames don't slow it
+			if (_blink.ticks <= elapsed)
 			{
 				_blink.ticks = kBlinkTicks;
 				_blink.state = !_blink.state;
 			}
+			else
+			{
+				_blink.ticks -= elapsed;
+			}
 		}
 		if (_blink.state)
 		{
@@ -329,40 +403,14 @@ void Display::run()
   }
 
   sendBuffer();
-
-  _dirty = _tuner.enabled || _blink.enabled;
 }
 
 void Display::drawScroll()
 {
-    constexpr uint8_t font_width = 10;
-    constexpr uint8_t font_height = 20;
-    constexpr uint8_t block_height = font_height;
-    constexpr uint8_t start_y = 23;
-
-	uint8_t text_offset = 0;
-	bool found_end = false;
-	const uint8_t max_chars = 20;
-	const uint8_t block_width = font_width * max_chars;
-	const uint8_t start_x = 48;
-	char name[max_chars + 2];
-	name[0] = '\0';
-	for (uint8_t i = 0; !found_end && i < max_chars + 1; ++i)
-	{
-		name[i] = _scroll.text[_scroll.letter + text_offset + i];
-		if (name[i] == '\0')
-		{
-			found_end = true;
-		}
-	}
-	name[max_chars + 1] = '\0';
-	text_offset += max_chars;
+    constexpr uint8_t font_width = kNameFontWidth;
+	const uint8_t text_offset = kNameChars;
 
-	u8g2_SetFont(&_u8g2, u8g2_font_10x20_tf);
-	u8g2_SetClipWindow(&_u8g2, start_x, start_y, start_x + block_width, start_y + block_height);
-	u8g2_DrawStr(&_u8g2, start_x - _scroll.pixel, start_y, name);
-	u8g2_SetMaxClipWindow(&_u8g2);
-		
+	blitName(_scroll.letter * font_width + _scroll.pixel);
 
 	if (_scroll.delay != 0)
 	{
@@ -389,6 +437,81 @@ void Display::drawScroll()
 	}
 }
 
+void Display::renderLabels()
+{
+	u8g2_ClearBuffer(&_u8g2);
+	u8g2_SetFont(&_u8g2, u8g2_font_7x13_mf);
+	for (uint8_t i = 0; i < Program::kNumSwitches; ++i)
+	{
+		drawFootswitch(i, _fs_text[i]);
+	}
+	std::copy(_u8g2_buffer.begin(), _u8g2_buffer.end(), _labels_layer.begin());
+	_labels_changed = false;
+}
+
+void Display::renderName()
+{
+	_name_strip.fill(0);
+	_name_changed = false;
+	if (!_scroll.text)
+	{
+		return;
+	}
+
+	// The strip is wider than the screen, so it takes a pass per screenful
+	const uint32_t width = u8g2_GetDisplayWidth(&_u8g2);
+	const uint32_t chars_per_pass = width / kNameFontWidth;
+	const uint32_t size = std::min<uint32_t>(_scroll.size, Program::kMaxNameLength);
+	u8g2_SetFont(&_u8g2, u8g2_font_10x20_tf);
+	for (uint32_t first = 0; first < size; first += chars_per_pass)
+	{
+		const uint32_t num_chars = std::min(chars_per_pass, size - first);
+		char chunk[Program::kMaxNameLength + 1];
+		memcpy(chunk, _scroll.text + first, num_chars);
+		chunk[num_chars] = '\0';
+
+		u8g2_ClearBuffer(&_u8g2);
+		u8g2_DrawStr(&_u8g2, 0, kNameY, chunk);
+		for (uint32_t row = 0; row < kNameTileRows; ++row)
+		{
+			memcpy(&_name_strip[row * kNameStripWidth + first * kNameFontWidth],
+			       &_u8g2_buffer[(kNameFirstTileRow + row) * width],
+			       num_chars * kNameFontWidth);
+		}
+	}
+}
+
+// Copies the name window, `offset` pixels into the strip, to the screen. The
+// name's tile rows are shared with the number and the bottom labels, so only
+// its own pixel rows and columns are replaced.
+void Display::blitName(uint32_t offset)
+{
+	const uint32_t width = u8g2_GetDisplayWidth(&_u8g2);
+	const uint32_t end = std::min<uint32_t>(kNameX + kNameChars * kNameFontWidth, width);
+	for (uint32_t row = 0; row < kNameTileRows; ++row)
+	{
+		const uint32_t tile_y = (kNameFirstTileRow + row) * 8;
+		uint8_t mask = 0;
+		for (uint32_t bit = 0; bit < 8; ++bit)
+		{
+			const uint32_t y = tile_y + bit;
+			if (y >= kNameY && y < kNameY + kNameFontHeight)
+			{
+				mask |= uint8_t(1 << bit);
+			}
+		}
+
+		const uint8_t* src = &_name_strip[row * kNameStripWidth];
+		uint8_t* dst = &_u8g2_buffer[(kNameFirstTileRow + row) * width];
+		for (uint32_t x = kNameX; x < end; ++x)
+		{
+			const uint32_t strip_x = offset + x - kNameX;
+			const uint8_t pixels = (strip_x < kNameStripWidth) ? src[strip_x] : 0;
+			dst[x] = uint8_t((dst[x] & ~mask) | (pixels & mask));
+		}
+	}
+}
+
 void Display::drawFrame(uint32_t x, uint32_t y, uint32_t width, uint32_t height, bool enabled)
 {
 	if (!is_pedal_long()) {
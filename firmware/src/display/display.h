@@ -16,6 +16,18 @@ class Display
 {
 public:
 	static constexpr uint8_t kNoNumber = 0xFF;
+	static constexpr uint32_t kDefaultFrameBudgetUs = 8000;
+
+	// Frame cost since the previous takeStats()
+	struct FrameStats
+	{
+		uint32_t last_us;
+		uint32_t max_us;
+		uint32_t total_us;
+		uint16_t rendered;
+		uint16_t skipped;
+	};
+
 	Display(const HWConfigDisplayI2C& configI2C, const HWConfigDisplaySPI& configSPI, const std::bitset<Program::kNumSwitches>& fs_state) :
 		_i2c{configI2C},
         _spi{configSPI},
@@ -25,14 +37,26 @@ public:
 	void showMessage(const char* text);
 	void setNumber(uint8_t number);
 	void setText(const char* text);
-	void setFootswitch(uint8_t idx, const char* text) { _fs_text[idx] = text; _dirty = true; }
-	void clearSwitches() { _fs_text = {}; }
+	void setFootswitch(uint8_t idx, const char* text) { _fs_text[idx] = text; _dirty = true; _labels_changed = true; }
+	void clearSwitches() { _fs_text = {}; _dirty = true; _labels_changed = true; }
 	void setBlink(bool enabled);
 	void setTuner(bool enabled, uint8_t note = 0, int8_t cents = 0);
 	void refresh() { _dirty = true; }
+
+	// Frames that only animate (blink, scroll, tuner) are dropped to keep up
+	// with the budget: every frame over it halves their rate, down to
+	// 1/kMaxFrameDivider, and a run of frames within half of it doubles the
+	// rate again. Frames showing a change -- new text, a switch turning on
+	// or off -- are always drawn.
+	void setFrameBudget(uint32_t budget_us) { _frame.budget_us = budget_us; }
+	uint32_t frameBudget() const { return _frame.budget_us; }
+	uint8_t frameDivider() const { return _frame.divider; }
+	FrameStats takeStats();
 	
 private:
 	static constexpr uint8_t kBlinkTicks = 8;
+	static constexpr uint8_t kMaxFrameDivider = 4;
+	static constexpr uint8_t kRecoverFrames = 30;
     static constexpr size_t kColumns = 256;
     static constexpr size_t kRows = 64;
     static constexpr size_t kRamRows = kRows;
@@ -42,6 +66,15 @@ private:
     static constexpr uint8_t kSetRowAddressCommand = 0x75;
     static constexpr uint8_t kSetColumnAddressCommand = 0x15;
     static constexpr uint8_t kWriteRamCommand = 0x5C;
+	// Scrolling program name: u8g2_font_10x20_tf is monospaced
+	static constexpr uint32_t kNameFontWidth = 10;
+	static constexpr uint32_t kNameFontHeight = 20;
+	static constexpr uint32_t kNameX = 48;
+	static constexpr uint32_t kNameY = 23;
+	static constexpr uint32_t kNameChars = 20;
+	static constexpr uint32_t kNameFirstTileRow = kNameY / 8;
+	static constexpr uint32_t kNameTileRows = (kNameY + kNameFontHeight - 1) / 8 - kNameFirstTileRow + 1;
+	static constexpr uint32_t kNameStripWidth = Program::kMaxNameLength * kNameFontWidth;
     
 	static uint8_t i2c_byte_cb(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int, void *arg_ptr);
 	static uint8_t gpio_and_delay_cb(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int, void *arg_ptr);
@@ -52,6 +85,14 @@ private:
 	void drawFootswitch(uint8_t idx, const char* text, bool draw_frame = false);
 	void drawFrame(uint32_t x, uint32_t y, uint32_t width, uint32_t height, bool enabled);
 	void drawScroll();
+	void renderLabels();
+	void renderName();
+	void blitName(uint32_t offset);
+	void render(uint8_t elapsed);
+	// Blink, tuner or a name wider than the screen (which scrolls): frames
+	// that change with nothing new set
+	bool animating() const { return _tuner.enabled || _blink.enabled || _scroll.size > kNameChars; }
+	void adaptRate(uint32_t cost_us);
 	void drawTuner();
     void sendBuffer();
     void fillBuffer();
@@ -71,6 +112,17 @@ private:
 	std::vector<uint8_t> _u8g2_buffer{};
     std::array<uint8_t, (kColumns / kColsPerByte) * kRows> _spi_buffer;
 
+	// Footswitch labels and the program name are rasterised once, when they
+	// change, instead of going through u8g2's font decoder every frame. Both
+	// are in the u8g2 buffer layout: columns of 8 vertical pixels, one tile
+	// row after the other. The labels layer is a whole frame, copied in as the
+	// background; the name strip holds the name's tile rows, unclipped, and
+	// scrolling is a window into it.
+	std::vector<uint8_t> _labels_layer{};
+	std::array<uint8_t, kNameTileRows * kNameStripWidth> _name_strip{};
+	bool _labels_changed = true;
+	bool _name_changed = true;
+
 	struct {
 		const char* text;
 		uint8_t letter;
@@ -84,6 +136,15 @@ private:
 		bool enabled;
 		bool state;
 	} _blink{};
+
+	struct {
+		uint32_t budget_us = kDefaultFrameBudgetUs;
+		uint8_t divider = 1;     // animation frames drawn: 1 in `divider`
+		uint8_t elapsed = 0;     // ticks since the last drawn frame
+		uint8_t within = 0;      // consecutive frames within half the budget
+		std::bitset<Program::kNumSwitches> fs_state{};  // as last drawn
+		FrameStats stats{};
+	} _frame{};
 	
 	struct {
 		char note[3];
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "hal.h"
+
+#include <cassert>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace tocata {
+
+// The board's NOR flash for host builds: programming can only clear bits and
+// erasing sets whole sectors back to 0xFF, like the real part, so the
+// filesystem can't get away with anything here that would break on hardware.
+// The image is a memory mapping, of a file when it has to survive restarts,
+// so accesses are plain memory operations rather than file I/O.
+//
+// Program and erase time isn't spent here: they return what the real chip
+// would take, and the HAL decides whether to wait for it.
+class FlashSim
+{
+public:
+    // Typical page program and sector erase times of the Pico's W25Q16JV
+    static constexpr uint32_t kPageProgramUs = 400;
+    static constexpr uint32_t kSectorEraseUs = 45000;
+
+    struct Stats
+    {
+        uint64_t bytes_read;
+        uint64_t pages_programmed;
+        uint64_t sectors_erased;
+        uint64_t busy_us;          // program and erase time the chip would take
+    };
+
+    // A chip of `size` bytes, the HAL's whole flash unless a benchmark wants
+    // a smaller one
+    explicit FlashSim(size_t size = kFlashSize) : _size(size), _erase_counts(size / kFlashSectorSize) {}
+    FlashSim(const FlashSim&) = delete;
+    FlashSim& operator=(const FlashSim&) = delete;
+    ~FlashSim()
+    {
+        if (_image)
+        {
+            munmap(_image, _size);
+        }
+    }
+
+    // Maps `path` as the flash image, growing it to the full size with erased
+    // bytes. Without a path the image is anonymous memory, erased.
+    bool open(const char* path = nullptr)
+    {
+        assert(!_image);
+        if (!path)
+        {
+            void* image = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (image == MAP_FAILED)
+            {
+                return false;
+            }
+            _image = static_cast<uint8_t*>(image);
+            memset(_image, 0xFF, _size);
+            return true;
+        }
+
+        const int fd = ::open(path, O_RDWR | O_CREAT, 0644);
+        if (fd < 0)
+        {
+            return false;
+        }
+        struct stat st;
+        const size_t size = (fstat(fd, &st) == 0) ? size_t(st.st_size) : 0;
+        if (size < _size && ftruncate(fd, _size) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        void* image = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        // The mapping keeps the file open
+        ::close(fd);
+        if (image == MAP_FAILED)
+        {
+            return false;
+        }
+        _image = static_cast<uint8_t*>(image);
+        if (size < _size)
+        {
+            memset(_image + size, 0xFF, _size - size);
+        }
+        return true;
+    }
+
+    uint8_t* image() { return _image; }
+    size_t size() const { return _size; }
+    size_t numSectors() const { return _erase_counts.size(); }
+    const Stats& stats() const { return _stats; }
+    uint32_t eraseCount(size_t sector) const { return _erase_counts[sector]; }
+
+    void read(uint32_t offset, void* dst, size_t count)
+    {
+        assert(offset + count <= _size);
+        memcpy(dst, _image + offset, count);
+        _stats.bytes_read += count;
+    }
+
+    uint32_t program(uint32_t offset, const void* src, size_t count)
+    {
+        assert(offset + count <= _size);
+        assert(offset % kFlashPageSize == 0);
+        assert(count % kFlashPageSize == 0);
+        const uint8_t* data = static_cast<const uint8_t*>(src);
+        uint8_t* dst = _image + offset;
+        for (size_t i = 0; i < count; ++i)
+        {
+            dst[i] &= data[i];
+        }
+        const uint32_t pages = uint32_t(count / kFlashPageSize);
+        _stats.pages_programmed += pages;
+        return busy(pages * kPageProgramUs);
+    }
+
+    uint32_t erase(uint32_t offset, size_t count)
+    {
+        assert(offset + count <= _size);
+        assert(offset % kFlashSectorSize == 0);
+        assert(count % kFlashSectorSize == 0);
+        memset(_image + offset, 0xFF, count);
+        const size_t first = offset / kFlashSectorSize;
+        const size_t sectors = count / kFlashSectorSize;
+        for (size_t sector = first; sector < first + sectors; ++sector)
+        {
+            ++_erase_counts[sector];
+        }
+        _stats.sectors_erased += sectors;
+        return busy(uint32_t(sectors) * kSectorEraseUs);
+    }
+
+private:
+    uint32_t busy(uint32_t us)
+    {
+        _stats.busy_us += us;
+        return us;
+    }
+
+    size_t _size;
+    uint8_t* _image = nullptr;
+    Stats _stats{};
+    std::vector<uint32_t> _erase_counts;
+};
+
+}
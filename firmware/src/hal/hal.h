@@ -44,6 +44,14 @@ struct HWConfigSwitches
     uint8_t map[10];
 };
 
+// A debounced change of the switch inputs: one bit per pressed switch, like
+// switches_value(), and when the edge happened
+struct SwitchEvent
+{
+    uint32_t time_us;
+    uint32_t value;
+};
+
 struct HWConfigLeds
 {
     int state_machine_id;
@@ -57,6 +65,21 @@ struct HWConfigExpression
     uint8_t connected_pin;
 };
 
+// The expression ADC free-runs at this rate, independent of the main loop
+constexpr uint32_t kExpressionSampleRate = 8000;
+
+// MIDI clock ticks per quarter note
+constexpr uint32_t kMidiClockPpq = 24;
+
+// How close to their due time the clock ticks went out, since the last
+// midi_clock_take_stats()
+struct MidiClockStats
+{
+    uint32_t late_max_us;
+    uint16_t ticks;
+    uint16_t deferred;      // ticks the alarm had to leave to the main loop
+};
+
 struct HWConfig
 {
     HWConfigSwitches switches;
@@ -0,0 +1,475 @@
+#include "hal.h"
+#ifdef HAL_HEADLESS
+
+#include "headless.h"
+#include "display_sim_sh1106.h"
+#include "display_sim_ssd1322.h"
+#include "flash_sim.h"
+
+#include <midi_parser.h>
+
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <cstdio>
+#include <cstdlib>
+
+namespace tocata {
+
+// Everything the firmware sees from the outside world comes from here, and
+// everything it sends is kept here, so a run depends on nothing but the script.
+
+namespace {
+
+template <typename Value>
+struct Timed
+{
+    uint64_t time_us;
+    Value value;
+};
+
+// Scripted input, kept sorted by time. Events scheduled for the same instant
+// stay in the order they were added.
+template <typename Value>
+class Timeline
+{
+public:
+    void add(uint64_t time_us, Value value)
+    {
+        auto pos = std::upper_bound(_events.begin(), _events.end(), time_us,
+            [](uint64_t time, const Timed<Value>& event) { return time < event.time_us; });
+        _events.insert(pos, Timed<Value>{time_us, std::move(value)});
+    }
+
+    bool due(uint64_t now) const { return !_events.empty() && _events.front().time_us <= now; }
+    uint64_t next() const { return _events.empty() ? UINT64_MAX : _events.front().time_us; }
+    Timed<Value>& front() { return _events.front(); }
+    void pop() { _events.pop_front(); }
+
+    // Visits the events already due, oldest first
+    template <typename Visitor>
+    void forEachDue(uint64_t now, Visitor&& visitor) const
+    {
+        for (auto& event : _events)
+        {
+            if (event.time_us > now) { break; }
+            visitor(event);
+        }
+    }
+
+private:
+    std::deque<Timed<Value>> _events;
+};
+
+uint64_t now_us = 0;
+uint32_t pass_cost_us = 10;
+
+Timeline<uint32_t> switch_events;
+uint32_t switches_applied = 0;
+
+Timeline<uint16_t> expression_events;
+uint16_t expression_applied = 0;
+bool expression_connected = false;
+uint64_t expression_last_us = 0;
+
+Timeline<std::vector<uint8_t>> midi_in_events;
+size_t midi_in_offset = 0;   // bytes of the front message already read
+
+std::vector<headless::MidiMessage> midi_out;
+MidiParser midi_out_parser;
+
+std::array<uint32_t, 8> led_colors{};
+
+DisplaySimSSD1322 display_ssd1322{};
+DisplaySimSH1106 display_sh1106{};
+uint64_t display_bytes = 0;
+std::vector<uint32_t> display_screen;
+
+// A fresh board: fully erased until the driver loads an image
+struct ErasedFlash : FlashSim
+{
+    ErasedFlash()
+    {
+        const bool opened = open();
+        assert(opened);
+    }
+} flash;
+bool flash_latency = false;
+
+uint32_t midi_clock_quarter_us;
+uint64_t midi_clock_start_us;
+uint32_t midi_clock_sent;
+MidiClockStats midi_clock_stats;
+
+int pedal_long = -1;   // unset: TOCATA_PEDAL_SHORT decides, like the SDL build
+
+}
+
+uint64_t headless_now()
+{
+    return now_us;
+}
+
+void headless_advance_to(uint64_t time_us)
+{
+    now_us = std::max(now_us, time_us);
+}
+
+void idle_until(uint32_t deadline)
+{
+    const int32_t delay = static_cast<int32_t>(deadline - micros());
+    if (delay > 0)
+    {
+        headless_advance_to(std::min(now_us + uint64_t(delay), headless::nextInput()));
+    }
+}
+
+void board_reset()
+{
+    printf("headless: board reset requested at %llu us\n", (unsigned long long)now_us);
+}
+
+// Flash
+
+void flash_read(uint32_t flash_offs, void *dst, size_t count)
+{
+    flash.read(flash_offs, dst, count);
+}
+
+void flash_write(uint32_t flash_offs, const void *data, size_t count)
+{
+    const uint32_t busy_us = flash.program(flash_offs, data, count);
+    if (flash_latency)
+    {
+        headless_advance_to(now_us + busy_us);
+    }
+}
+
+void flash_erase(uint32_t flash_offs, size_t count)
+{
+    const uint32_t busy_us = flash.erase(flash_offs, count);
+    if (flash_latency)
+    {
+        headless_advance_to(now_us + busy_us);
+    }
+}
+
+// Switches
+
+uint32_t switches_value(const HWConfigSwitches&)
+{
+    uint32_t value = switches_applied;
+    switch_events.forEachDue(now_us, [&](const Timed<uint32_t>& event) { value = event.value; });
+    return value;
+}
+
+// Scripted edges are already clean, and carry their scheduled time so input
+// latency can be measured from the moment the switch was actually pressed
+bool switches_pop_event(const HWConfigSwitches&, SwitchEvent& event)
+{
+    if (!switch_events.due(now_us))
+    {
+        return false;
+    }
+    auto& front = switch_events.front();
+    switches_applied = front.value;
+    event = {.time_us = uint32_t(front.time_us), .value = front.value};
+    switch_events.pop();
+    return true;
+}
+
+// Expression
+
+bool expression_is_connected(const HWConfigExpression&)
+{
+    return expression_connected;
+}
+
+// As many samples as the ADC would have converted since the last read, each
+// with the value scripted for its own conversion time
+size_t expression_read(const HWConfigExpression&, uint16_t* samples, size_t max)
+{
+    constexpr uint64_t kSamplePeriodUs = 1000000 / kExpressionSampleRate;
+    size_t count = 0;
+    while (count < max && expression_last_us + kSamplePeriodUs <= now_us)
+    {
+        expression_last_us += kSamplePeriodUs;
+        while (expression_events.due(expression_last_us))
+        {
+            expression_applied = expression_events.front().value;
+            expression_events.pop();
+        }
+        samples[count++] = expression_applied;
+    }
+    return count;
+}
+
+// MIDI clock, counted from virtual time
+
+void midi_clock_start(uint32_t quarter_us)
+{
+    midi_clock_quarter_us = quarter_us;
+    midi_clock_start_us = now_us;
+    midi_clock_sent = 0;
+}
+
+void midi_clock_stop()
+{
+    midi_clock_quarter_us = 0;
+}
+
+uint32_t midi_clock_ticks()
+{
+    if (midi_clock_quarter_us == 0)
+    {
+        return 0;
+    }
+    const uint64_t elapsed = now_us - midi_clock_start_us;
+    const uint32_t due = 1 + uint32_t(elapsed * kMidiClockPpq / midi_clock_quarter_us);
+    const uint32_t ticks = due - midi_clock_sent;
+    if (ticks > 0)
+    {
+        const uint64_t oldest_us = uint64_t(midi_clock_sent) * midi_clock_quarter_us / kMidiClockPpq;
+        midi_clock_stats.late_max_us = std::max(midi_clock_stats.late_max_us, uint32_t(elapsed - oldest_us));
+        midi_clock_stats.ticks += ticks;
+    }
+    static constexpr unsigned char kClock[] = {0xF8};
+    for (uint32_t tick = 0; tick < ticks; ++tick)
+    {
+        usb_midi_write(kClock, sizeof(kClock));
+    }
+    midi_clock_sent = due;
+    return ticks;
+}
+
+MidiClockStats midi_clock_take_stats()
+{
+    const MidiClockStats stats = midi_clock_stats;
+    midi_clock_stats = {};
+    return stats;
+}
+
+// Leds
+
+void leds_refresh(const HWConfigLeds&, const uint32_t* leds, size_t num_leds)
+{
+    std::copy_n(leds, std::min(num_leds, led_colors.size()), led_colors.begin());
+}
+
+// Display
+
+static DisplaySim& display_sim()
+{
+    return is_pedal_long() ? (DisplaySim&)display_ssd1322 : (DisplaySim&)display_sh1106;
+}
+
+void i2c_write(uint8_t addr, const uint8_t *src, size_t len)
+{
+    display_bytes += len;
+    if (!display_sim().processTransfer(src, uint32_t(len)))
+    {
+        printf("headless: invalid %u byte I2C transfer to %02X\n", (uint32_t)len, addr);
+    }
+}
+
+void spi_transfer(const uint8_t *src, size_t len)
+{
+    display_bytes += len;
+    if (!display_sim().processTransfer(src, uint32_t(len)))
+    {
+        printf("headless: invalid %u byte SPI transfer\n", (uint32_t)len);
+    }
+}
+
+void spi_set_dc(bool enabled)
+{
+    display_sim().setControlData(enabled);
+}
+
+void spi_set_reset(bool) {}
+
+void spi_set_cs(bool) {}
+
+// USB
+
+void usb_init() {}
+
+// Every pass of the main loop, and of the firmware's busy-wait loops, goes
+// through here: charging it some virtual time is what lets those loops end
+void usb_run()
+{
+    headless_advance_to(now_us + pass_cost_us);
+}
+
+uint32_t usb_midi_available()
+{
+    uint32_t available = 0;
+    midi_in_events.forEachDue(now_us, [&](const Timed<std::vector<uint8_t>>& event) {
+        available += uint32_t(event.value.size());
+    });
+    return available - uint32_t(midi_in_offset);
+}
+
+uint32_t usb_midi_stream_read(void* buffer, uint32_t bufsize)
+{
+    uint8_t* dst = static_cast<uint8_t*>(buffer);
+    uint32_t read = 0;
+    while (read < bufsize && midi_in_events.due(now_us))
+    {
+        auto& message = midi_in_events.front().value;
+        const size_t count = std::min<size_t>(bufsize - read, message.size() - midi_in_offset);
+        memcpy(dst + read, message.data() + midi_in_offset, count);
+        read += uint32_t(count);
+        midi_in_offset += count;
+        if (midi_in_offset == message.size())
+        {
+            midi_in_events.pop();
+            midi_in_offset = 0;
+        }
+    }
+    return read;
+}
+
+// The USB queue hands over whatever is contiguous, which may be several
+// messages or part of a SysEx, so split it back into messages here
+size_t usb_midi_write(const unsigned char* message, size_t size)
+{
+    midi_out_parser.parse({message, size}, [](std::span<const uint8_t> parsed) {
+        midi_out.push_back({now_us, {parsed.begin(), parsed.end()}});
+    });
+    return size;
+}
+
+bool is_pedal_long()
+{
+    if (pedal_long < 0)
+    {
+        pedal_long = !std::getenv("TOCATA_PEDAL_SHORT");
+    }
+    return pedal_long != 0;
+}
+
+namespace headless {
+
+uint64_t now()
+{
+    return now_us;
+}
+
+void advanceTo(uint64_t time_us)
+{
+    headless_advance_to(time_us);
+}
+
+void setPassCost(uint32_t us)
+{
+    pass_cost_us = std::max<uint32_t>(us, 1);
+}
+
+void setPedalLong(bool is_long)
+{
+    pedal_long = is_long;
+}
+
+void setSwitches(uint64_t time_us, uint32_t value)
+{
+    switch_events.add(time_us, value);
+}
+
+void setExpression(uint64_t time_us, uint16_t raw)
+{
+    expression_events.add(time_us, raw);
+}
+
+void setExpressionConnected(bool connected)
+{
+    expression_connected = connected;
+}
+
+void sendMidi(uint64_t time_us, std::span<const uint8_t> message)
+{
+    midi_in_events.add(time_us, {message.begin(), message.end()});
+}
+
+uint64_t nextInput()
+{
+    // Expression changes don't count: the firmware samples the pedal on its
+    // own schedule, as it does the free-running ADC
+    return std::min(switch_events.next(), midi_in_events.next());
+}
+
+const std::vector<MidiMessage>& midiOut()
+{
+    return midi_out;
+}
+
+void clearMidiOut()
+{
+    midi_out.clear();
+}
+
+std::span<const uint32_t> leds()
+{
+    return led_colors;
+}
+
+DisplaySim& display()
+{
+    return display_sim();
+}
+
+uint64_t displayBytes()
+{
+    return display_bytes;
+}
+
+void copyFramebuffer(std::vector<uint8_t>& pixels)
+{
+    static uint32_t colors[] = {0, 1};
+    DisplaySim& sim = display_sim();
+    // refresh() only redraws what changed since the last call, so the decoded
+    // screen has to persist between copies
+    display_screen.resize(sim.numRows() * sim.numColumns());
+    sim.refresh(display_screen.data(), sim.numColumns(), colors);
+    pixels.assign(display_screen.begin(), display_screen.end());
+}
+
+void setFlashLatency(bool enabled)
+{
+    flash_latency = enabled;
+}
+
+const FlashSim& flashSim()
+{
+    return flash;
+}
+
+bool loadFlash(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        return false;
+    }
+    const size_t read = fread(flash.image(), 1, kFlashSize, file);
+    fclose(file);
+    return read == kFlashSize;
+}
+
+bool saveFlash(const char* path)
+{
+    FILE* file = fopen(path, "wb");
+    if (!file)
+    {
+        return false;
+    }
+    const size_t written = fwrite(flash.image(), 1, kFlashSize, file);
+    fclose(file);
+    return written == kFlashSize;
+}
+
+}
+
+}
+
+#endif // HAL_HEADLESS
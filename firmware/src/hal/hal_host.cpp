@@ -1,17 +1,19 @@
 #include "hal.h"
-#ifndef HAL_PICO
+#if !defined(HAL_PICO) && !defined(HAL_HEADLESS)
 
 #include "display_sim_sh1106.h"
 #include "display_sim_ssd1322.h"
+#include "flash_sim.h"
 #include "application.h"
 
 #include <midi_sysex.h>
+#include <spsc_ring.h>
 #include <config.h>
 #include <libremidi/libremidi.hpp>
 
+#include <algorithm>
+#include <atomic>
 #include <functional>
-#include <deque>
-#include <mutex>
 #include <optional>
 #include <string_view>
 #include <vector>
@@ -20,8 +22,6 @@
 
 namespace tocata {
 
-uint8_t MemFlash[2 * 1024 * 1024];
-
 static libremidi::midi_out midi{};
 static DisplaySimSSD1322 display_ssd1322{};
 static DisplaySimSH1106 display_sh1106{};
@@ -69,7 +69,7 @@ void spi_set_reset(bool enabled) {
 void spi_set_cs(bool enabled) {
 }
 
-void leds_refresh(const HWConfigLeds& config, uint32_t* leds, size_t num_leds)
+void leds_refresh(const HWConfigLeds& config, const uint32_t* leds, size_t num_leds)
 {
   auto adjust = [](uint32_t v32) -> uint8_t {
     uint8_t v8 = static_cast<uint8_t>(v32);
@@ -90,75 +90,51 @@ uint32_t switches_value(const HWConfigSwitches& config)
   return app.switchesValue();
 }
 
-static FILE* flash;
+// The simulated switches don't bounce: every change is an event
+bool switches_pop_event(const HWConfigSwitches& config, SwitchEvent& event)
+{
+  static uint32_t last = ~0u;
+  const uint32_t value = switches_value(config);
+  if (value == last) {
+    return false;
+  }
+  last = value;
+  event = {.time_us = micros(), .value = value};
+  return true;
+}
+
+// The flash image persists in kFlashPath across runs. TOCATA_FLASH_LATENCY
+// makes program and erase operations take as long as on the board.
+static FlashSim flash;
+static bool flash_latency;
 constexpr const char* kFlashPath = "/tmp/tocata_flash";
 
 void flash_init() 
 {
-  flash = fopen(kFlashPath, "a");
-  assert(flash);  
-  fclose(flash);
-  flash = fopen(kFlashPath, "r+");
-  assert(flash);  
-  fseek(flash, kFlashSize - 1, SEEK_SET);
-  int c = fgetc(flash);
-  c = (c == EOF) ? 0xFF : c;
-  fseek(flash, kFlashSize - 1, SEEK_SET);
-  int new_c = fputc(c, flash);  
-  assert(c == new_c);
-  fflush(flash);
+  const bool opened = flash.open(kFlashPath);
+  assert(opened);
+  flash_latency = std::getenv("TOCATA_FLASH_LATENCY");
 }
 
 void flash_read(uint32_t flash_offs, void *dst, size_t count) 
 {
-  assert(flash_offs + count <= kFlashSize);
-  fseek(flash, flash_offs, SEEK_SET);
-  size_t ret = fread(dst, count, 1, flash);
-  assert(ret == 1);
-    // printf("flash_read 0x%08X %u bytes\n", flash_offs, (uint32_t)count);
-    // memcpy(dst, MemFlash + flash_offs, count);
+  flash.read(flash_offs, dst, count);
 }
 
 void flash_write(uint32_t flash_offs, const void *data, size_t count) 
 {
-    assert(flash_offs + count <= kFlashSize);
-    assert(flash_offs % kFlashPageSize == 0);
-    assert(count % kFlashPageSize == 0);
-    uint8_t* buffer = new uint8_t[count];
-    flash_read(flash_offs, buffer, count);
-    for (size_t i = 0; i < count; ++i)
-    {
-        buffer[i] &= static_cast<const uint8_t*>(data)[i];
-    }
-    fseek(flash, flash_offs, SEEK_SET);
-    size_t ret = fwrite(buffer, count, 1, flash);
-    assert(ret == 1);
-    fflush(flash);
-    delete[] buffer;
-
-    // printf("flash_write 0x%08X %u bytes\n", flash_offs, (uint32_t)count);
-    // for (size_t i = 0; i < count; ++i)
-    // {
-    //     MemFlash[flash_offs + i] &= static_cast<const uint8_t*>(data)[i];
-    // }
+  const uint32_t busy_us = flash.program(flash_offs, data, count);
+  if (flash_latency) {
+    std::this_thread::sleep_for(std::chrono::microseconds(busy_us));
+  }
 }
 
 void flash_erase(uint32_t flash_offs, size_t count) 
 {
-    assert(flash_offs + count <= kFlashSize);
-    assert(flash_offs % kFlashSectorSize == 0);
-    assert(count % kFlashSectorSize == 0);
-
-    uint8_t* buffer = new uint8_t[count];
-    memset(buffer, 0xFF, count);    
-    fseek(flash, flash_offs, SEEK_SET);
-    size_t ret = fwrite(buffer, count, 1, flash);
-    assert(ret == 1);
-    fflush(flash);
-    delete[] buffer;
-    
-    // printf("flash_erase 0x%08X %u bytes\n", flash_offs, (uint32_t)count);
-    // memset(MemFlash + flash_offs, 0xFF, count);
+  const uint32_t busy_us = flash.erase(flash_offs, count);
+  if (flash_latency) {
+    std::this_thread::sleep_for(std::chrono::microseconds(busy_us));
+  }
 }
 
 // All incoming MIDI (regular PC/CC/Note *and* SysEx) is queued here by the
@@ -169,33 +145,33 @@ void flash_erase(uint32_t flash_offs, size_t count)
 // program/scene/tuner changes, and SysEx is handled by ConfigProtocol::processSysEx
 // (config) or answered as a MIDI identity request. This keeps host behavior
 // identical to hardware.
-static std::mutex midi_in_mutex;
-static std::deque<uint8_t> midi_in_queue;
+//
+// The callback thread is the ring's only producer and the main thread its only
+// consumer, so no lock is needed. A message that doesn't fit is dropped whole
+// rather than truncated.
+static SpscRing<1 << 16> midi_in_ring;
+static std::atomic<uint32_t> midi_in_dropped{0};
 
 static libremidi::midi_in midi_in{
   libremidi::input_configuration{
     .on_message = [](const libremidi::message& message) {
-      std::lock_guard<std::mutex> lock(midi_in_mutex);
-      midi_in_queue.insert(midi_in_queue.end(), message.begin(), message.end());
+      if (!midi_in_ring.write({message.begin(), message.end()})) {
+        midi_in_dropped.fetch_add(1, std::memory_order_relaxed);
+      }
     },
     .ignore_sysex = false,
   }
 };
 
 uint32_t usb_midi_available() {
-  std::lock_guard<std::mutex> lock(midi_in_mutex);
-  return uint32_t(midi_in_queue.size());
+  if (auto dropped = midi_in_dropped.exchange(0, std::memory_order_relaxed)) {
+    printf("MIDI input ring full, dropped %u messages\n", dropped);
+  }
+  return uint32_t(midi_in_ring.size());
 }
 
 uint32_t usb_midi_stream_read(void* buffer, uint32_t bufsize) {
-  std::lock_guard<std::mutex> lock(midi_in_mutex);
-  uint32_t count = std::min<uint32_t>(bufsize, uint32_t(midi_in_queue.size()));
-  auto* out = static_cast<uint8_t*>(buffer);
-  for (uint32_t i = 0; i < count; ++i) {
-    out[i] = midi_in_queue.front();
-    midi_in_queue.pop_front();
-  }
-  return count;
+  return uint32_t(midi_in_ring.read({static_cast<uint8_t*>(buffer), bufsize}));
 }
 
 template <typename Port>
@@ -259,7 +235,7 @@ size_t usb_midi_write(const unsigned char* message, size_t size) {
 void board_reset() {
 }
 
-uint16_t expression_read(const HWConfigExpression& config) {
+static uint16_t expression_sample() {
   constexpr int16_t kMargin = 1 << 5;
   constexpr int16_t kMin = kMargin;
   constexpr int16_t kMax = (1 << 12) - kMargin;
@@ -283,6 +259,60 @@ uint16_t expression_read(const HWConfigExpression& config) {
   return static_cast<uint16_t>(exp_value);
 }
 
+// One simulated sweep step per call, repeated for as many samples as the
+// real ADC would have converted in the meantime
+size_t expression_read(const HWConfigExpression& config, uint16_t* samples, size_t max) {
+  static uint32_t last_us = micros();
+  const uint32_t now = micros();
+  const size_t count = std::min<size_t>(max, size_t(now - last_us) * kExpressionSampleRate / 1000000);
+  last_us += uint32_t(count * 1000000 / kExpressionSampleRate);
+  std::fill_n(samples, count, expression_sample());
+  return count;
+}
+
+// Ticks are counted from elapsed time, like the expression samples above
+static uint32_t midi_clock_quarter_us;
+static uint32_t midi_clock_start_us;
+static uint32_t midi_clock_sent;
+static MidiClockStats midi_clock_stats;
+
+void midi_clock_start(uint32_t quarter_us) {
+  midi_clock_quarter_us = quarter_us;
+  midi_clock_start_us = micros();
+  midi_clock_sent = 0;
+}
+
+void midi_clock_stop() {
+  midi_clock_quarter_us = 0;
+}
+
+uint32_t midi_clock_ticks() {
+  if (midi_clock_quarter_us == 0) {
+    return 0;
+  }
+  const uint64_t elapsed = micros() - midi_clock_start_us;
+  // The first tick is due right away, on the tap
+  const uint32_t due = 1 + uint32_t(elapsed * kMidiClockPpq / midi_clock_quarter_us);
+  const uint32_t ticks = due - midi_clock_sent;
+  if (ticks > 0) {
+    const uint64_t oldest_us = uint64_t(midi_clock_sent) * midi_clock_quarter_us / kMidiClockPpq;
+    midi_clock_stats.late_max_us = std::max(midi_clock_stats.late_max_us, uint32_t(elapsed - oldest_us));
+    midi_clock_stats.ticks += ticks;
+  }
+  static constexpr unsigned char kClock[] = {0xF8};
+  for (uint32_t tick = 0; tick < ticks; ++tick) {
+    usb_midi_write(kClock, sizeof(kClock));
+  }
+  midi_clock_sent = due;
+  return ticks;
+}
+
+MidiClockStats midi_clock_take_stats() {
+  const MidiClockStats stats = midi_clock_stats;
+  midi_clock_stats = {};
+  return stats;
+}
+
 bool is_pedal_long() {
   static bool init;
   static bool is_long;
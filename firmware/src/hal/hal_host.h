@@ -4,14 +4,35 @@
 #include <thread>
 #include <cstring>
 #include <cassert>
+#include <algorithm>
 
 namespace tocata {
 
 // System
+#ifdef HAL_HEADLESS
+// Virtual clock owned by the headless driver (see headless.h): it only moves
+// when the firmware idles or sleeps, or when the driver advances it
+uint64_t headless_now();
+void headless_advance_to(uint64_t time_us);
+static inline uint32_t millis() { return uint32_t(headless_now() / 1000); }
+static inline uint32_t micros() { return uint32_t(headless_now()); }
+static inline void sleep_ms(uint32_t ms) { headless_advance_to(headless_now() + uint64_t(ms) * 1000); }
+// Jumps straight to the deadline, or to the next scripted input if that
+// comes first, like an interrupt waking the real board
+void idle_until(uint32_t deadline);
+#else
 static inline uint32_t millis() { return uint32_t(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()); }
 static inline uint32_t micros() { return uint32_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()); }
 static inline void sleep_ms(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
-static inline void idle_loop() { sleep_ms(1); }
+// No interrupts to wake up on: input arrives on other threads, so never
+// sleep for more than a millisecond
+static inline void idle_until(uint32_t deadline) {
+    const int32_t delay = static_cast<int32_t>(deadline - micros());
+    if (delay > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(std::min<int32_t>(delay, 1000)));
+    }
+}
+#endif
 static inline void board_program() {}
 
 void board_reset();
@@ -22,7 +43,8 @@ static constexpr uint32_t kFlashAddress = 0x10000000;
 static constexpr uint32_t kFlashSectorSize = 4 * 1024;
 static constexpr uint32_t kFlashPageSize = 256;
 static constexpr uint32_t kFlashPartitionOffset = 512 * 1024;
-static constexpr uint32_t kFlashPartitionSize = 128 * 1024;
+// Four 64K filesystem blocks, as on the board
+static constexpr uint32_t kFlashPartitionSize = 4 * 64 * 1024;
 static constexpr uint32_t kFlashSize = 2 * 1024 * 1024;
 
 void flash_read(uint32_t flash_offs, void *dst, size_t count);
@@ -33,29 +55,43 @@ void flash_erase(uint32_t flash_offs, size_t count);
 
 // Switches
 
-static inline void switches_init(const HWConfigSwitches& config, uint8_t num_switches) {}
+static inline void switches_init(const HWConfigSwitches&, uint8_t) {}
 
 uint32_t switches_value(const HWConfigSwitches& config);
+bool switches_pop_event(const HWConfigSwitches& config, SwitchEvent& event);
 
 // Expression
 
-static inline void expression_init(const HWConfigExpression& config) {}
-uint16_t expression_read(const HWConfigExpression& config);
-static inline bool expression_is_connected(const HWConfigExpression& config) { return false; }
+static inline void expression_init(const HWConfigExpression&) {}
+size_t expression_read(const HWConfigExpression& config, uint16_t* samples, size_t max);
+#ifdef HAL_HEADLESS
+bool expression_is_connected(const HWConfigExpression& config);
+#else
+static inline bool expression_is_connected(const HWConfigExpression&) { return false; }
+#endif
+
+// MIDI clock: no alarm to send from, so midi_clock_ticks() sends the 0xF8
+// of every tick that fell due to USB itself, from the loop
+
+void midi_clock_start(uint32_t quarter_us);
+void midi_clock_stop();
+uint32_t midi_clock_ticks();
+MidiClockStats midi_clock_take_stats();
 
 // Leds
 
-static inline void leds_init(const HWConfigLeds& config) {}
+static inline void leds_init(const HWConfigLeds&) {}
 
-void leds_refresh(const HWConfigLeds& config, uint32_t* leds, size_t num_leds);
+static inline bool leds_busy() { return false; }
+void leds_refresh(const HWConfigLeds& config, const uint32_t* leds, size_t num_leds);
 
 // I2C
 
-static inline void i2c_init(uint32_t baudrate, const HWConfigI2C& config) {}
+static inline void i2c_init(uint32_t, const HWConfigI2C&) {}
 void i2c_write(uint8_t addr, const uint8_t *src, size_t len);
 
 //SPI
-static inline void spi_init(const HWConfigDisplaySPI& config) {}
+static inline void spi_init(const HWConfigDisplaySPI&) {}
 void spi_transfer(const uint8_t *src, size_t len);
 void spi_set_dc(bool enabled);
 void spi_set_reset(bool enabled);
@@ -64,7 +100,7 @@ void spi_set_cs(bool enabled);
 // BOARD LED
 
 static inline void board_led_init() {}
-static inline void board_led_enable(bool enabled) {}
+static inline void board_led_enable(bool) {}
 
 // USB
 
@@ -72,6 +108,7 @@ void usb_init();
 void usb_run();
 
 // USB midi
+static inline bool usb_midi_connected() { return true; }
 uint32_t usb_midi_available();
 uint32_t usb_midi_stream_read(void* buffer, uint32_t bufsize);
 size_t usb_midi_write(const unsigned char* message, size_t size);
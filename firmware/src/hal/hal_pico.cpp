@@ -3,6 +3,13 @@
 #ifdef HAL_PICO
 
 #include "usb_device.h"
+#include "spsc_ring.h"
+
+#include <pico/sync.h>
+#include <hardware/irq.h>
+
+#include <algorithm>
+#include <atomic>
 
 extern "C" {
 
@@ -68,43 +75,232 @@ static void bytes_to_hex(char* dst, uint8_t* bytes, size_t length)
 
 #if MEMFLASH
 uint8_t MemFlash[kFlashSize];
+
+void flash_flush() {}
+#else
+
+// Flash writes are queued to core 1, one erase range or page program per
+// entry. The binary is copied to RAM at boot so core 0 never fetches code from
+// XIP; the only thing it can't do while core 1 has the flash busy is read flash
+// data. Reads therefore take flash_xip_mutex, which core 1 holds only for the
+// duration of a single sector or page operation, and then overlay whatever is
+// still queued so callers see their own writes immediately. A reader announces
+// itself through flash_reader_waiting and core 1 stays off the mutex until it
+// is done, so a read waits for at most one operation, never a whole block.
+
+namespace {
+
+struct FlashOp {
+  enum Type : uint8_t { kErase, kProgram };
+  Type type;
+  uint32_t offset;
+  // Bytes still to erase; core 1 erases a sector at a time and shrinks the
+  // range in place, so a 64K block takes one entry however long it runs
+  uint32_t size;
+  uint8_t data[kFlashPageSize];
+};
+
+// Power of two so the free-running indices can be reduced with a modulo. A
+// block erase is one entry and a file write three pages, so this holds several
+// saves queued behind a collection without core 0 having to wait for room.
+static constexpr uint32_t kFlashQueueSize = 16;
+
+FlashOp flash_queue[kFlashQueueSize];
+// flash_head and the op at the head are only written by core 1, with
+// flash_xip_mutex held, so a reader holding the mutex sees the flash contents
+// and the pending ops consistently.
+std::atomic<uint32_t> flash_head{0};
+std::atomic<uint32_t> flash_tail{0};
+std::atomic<bool> flash_reader_waiting{false};
+mutex_t flash_xip_mutex;
+
+void flash_core1_entry()
+{
+  while (true)
+  {
+    const uint32_t head = flash_head.load(std::memory_order_relaxed);
+    if (head == flash_tail.load(std::memory_order_acquire) ||
+        flash_reader_waiting.load(std::memory_order_acquire))
+    {
+      // Either the queue or the reader signals when this changes
+      __wfe();
+      continue;
+    }
+
+    FlashOp& op = flash_queue[head % kFlashQueueSize];
+    mutex_enter_blocking(&flash_xip_mutex);
+    const uint32_t irq = save_and_disable_interrupts();
+    bool done = true;
+    if (op.type == FlashOp::kErase)
+    {
+      flash_range_erase(op.offset, kFlashSectorSize);
+      op.offset += kFlashSectorSize;
+      op.size -= kFlashSectorSize;
+      done = (op.size == 0);
+    }
+    else
+    {
+      flash_range_program(op.offset, op.data, kFlashPageSize);
+    }
+    restore_interrupts(irq);
+    if (done)
+    {
+      flash_head.store(head + 1, std::memory_order_release);
+    }
+    mutex_exit(&flash_xip_mutex);
+    __sev();
+  }
+}
+
+FlashOp& flash_queue_reserve()
+{
+  const uint32_t tail = flash_tail.load(std::memory_order_relaxed);
+  while (tail - flash_head.load(std::memory_order_acquire) >= kFlashQueueSize)
+  {
+    // Core 1 signals after every operation
+    __wfe();
+  }
+  return flash_queue[tail % kFlashQueueSize];
+}
+
+void flash_queue_commit()
+{
+  flash_tail.fetch_add(1, std::memory_order_release);
+  __sev();
+}
+
+void flash_overlay(const FlashOp& op, uint32_t flash_offs, uint8_t* dst, size_t count)
+{
+  const uint32_t op_size = (op.type == FlashOp::kErase) ? op.size : kFlashPageSize;
+  const uint32_t begin = std::max<uint32_t>(op.offset, flash_offs);
+  const uint32_t end = std::min<uint32_t>(op.offset + op_size, flash_offs + count);
+  for (uint32_t addr = begin; addr < end; ++addr)
+  {
+    if (op.type == FlashOp::kErase)
+    {
+      dst[addr - flash_offs] = 0xFF;
+    }
+    else
+    {
+      dst[addr - flash_offs] &= op.data[addr - op.offset];
+    }
+  }
+}
+
+} // namespace
+
+void flash_worker_init()
+{
+  mutex_init(&flash_xip_mutex);
+  multicore_launch_core1(flash_core1_entry);
+}
+
+void flash_worker_read(uint32_t flash_offs, void *dst, size_t count)
+{
+  const uint8_t* flash = reinterpret_cast<const uint8_t*>(XIP_BASE);
+  // Core 1 finishes the operation it's on, if any, and then waits for us
+  flash_reader_waiting.store(true, std::memory_order_release);
+  mutex_enter_blocking(&flash_xip_mutex);
+  flash_reader_waiting.store(false, std::memory_order_relaxed);
+  memcpy(dst, flash + flash_offs, count);
+  // Replaying an op that already reached flash is harmless: the queue is
+  // applied in order and erase/program are idempotent from any earlier state.
+  const uint32_t tail = flash_tail.load(std::memory_order_relaxed);
+  for (uint32_t i = flash_head.load(std::memory_order_acquire); i != tail; ++i)
+  {
+    flash_overlay(flash_queue[i % kFlashQueueSize], flash_offs, static_cast<uint8_t*>(dst), count);
+  }
+  mutex_exit(&flash_xip_mutex);
+  __sev();
+}
+
+void flash_worker_program(uint32_t flash_offs, const uint8_t *data, size_t count)
+{
+  for (size_t offset = 0; offset < count; offset += kFlashPageSize)
+  {
+    const uint8_t* page = data + offset;
+    // Programming 0xFF leaves flash untouched, and the file system pads every
+    // partial write with it
+    if (std::all_of(page, page + kFlashPageSize, [](uint8_t b) { return b == 0xFF; }))
+    {
+      continue;
+    }
+
+    FlashOp& op = flash_queue_reserve();
+    op.type = FlashOp::kProgram;
+    op.offset = flash_offs + offset;
+    memcpy(op.data, page, kFlashPageSize);
+    flash_queue_commit();
+  }
+}
+
+void flash_worker_erase(uint32_t flash_offs, size_t count)
+{
+  if (count == 0)
+  {
+    return;
+  }
+  // Core 1 erases one sector at a time, so a reader is still kept waiting for
+  // a single sector erase at most, not for the whole range
+  FlashOp& op = flash_queue_reserve();
+  op.type = FlashOp::kErase;
+  op.offset = flash_offs;
+  op.size = uint32_t(count);
+  flash_queue_commit();
+}
+
+void flash_flush()
+{
+  while (flash_head.load(std::memory_order_acquire) != flash_tail.load(std::memory_order_relaxed))
+  {
+    __wfe();
+  }
+}
 #endif
 
+static void usb_cdc_write(const char *buf, int len)
+{
+  if (!tud_cdc_connected()) {
+    return;
+  }
+
+  int sent = 0;
+  while (sent < len)
+  {
+    while (tud_cdc_connected() && !tud_cdc_write_available())
+    {
+      tud_task();
+    }
+
+    if (!tud_cdc_connected()) {
+      return;
+    }
+
+    int written = tud_cdc_write(buf + sent, len - sent);
+    sent += written;
+  }
+}
+
 void usb_init()
 {
   static struct stdio_driver usb_stdio = {
     .out_chars = [](const char *buf, int len) {
-      if (!tud_cdc_connected()) {
-        return;
-      }
-
-      int sent = 0;
-      bool blocked = false;
-      while (sent < len)
-      {
-        while (tud_cdc_connected() && !tud_cdc_write_available())
-        {
-          tud_task();
-        }
-
-        if (!tud_cdc_connected()) {
-          return;
-        }
-
-        int written = tud_cdc_write(buf + sent, len - sent);
-        sent += written;
-      }
+      usb_lock();
+      usb_cdc_write(buf, len);
+      usb_unlock();
     },
     .out_flush = []() {
+      usb_lock();
       if (tud_cdc_connected()) {
         tud_cdc_write_flush();
       }
+      usb_unlock();
     },
     .in_chars = [](char *buf, int len) { 
-      if (!tud_cdc_connected()) {
-        return 0;
-      }
-      return (int)tud_cdc_read(buf, (uint32_t)len); 
+      usb_lock();
+      const int read = tud_cdc_connected() ? (int)tud_cdc_read(buf, (uint32_t)len) : 0;
+      usb_unlock();
+      return read;
     },
     .crlf_enabled = PICO_STDIO_DEFAULT_CRLF,
   };
@@ -127,6 +323,286 @@ void usb_init()
   stdio_set_driver_enabled(&usb_stdio, true);
 }
 
+// Switches: the switches PIO program debounces the pins and pushes every new
+// stable state; the FIFO IRQ stamps it and queues it for the main loop, so
+// edge times don't depend on how busy the loop is.
+static const HWConfigSwitches* switches_config;
+static SpscRing<64 * sizeof(SwitchEvent)> switches_events;
+
+static void switches_irq()
+{
+  const uint sm = switches_config->state_machine_id;
+  while (!pio_sm_is_rx_fifo_empty(pio0, sm)) {
+    // Stamped on arrival: the edge itself was one debounce window earlier
+    const SwitchEvent event = {
+      .time_us = time_us_32() - switches_debounce_us,
+      .value = ~pio_sm_get(pio0, sm),
+    };
+    // Dropped only if the loop stalls for 64 edges. Each event carries the
+    // whole state, so the next one resyncs the switches.
+    switches_events.write({reinterpret_cast<const uint8_t*>(&event), sizeof(event)});
+  }
+}
+
+void switches_init(const HWConfigSwitches& config, uint8_t num_switches)
+{
+  switches_config = &config;
+  const uint sm = config.state_machine_id;
+  pio_sm_claim(pio0, sm);
+  const uint offset = switches_program_add(pio0, num_switches);
+  switches_program_init(pio0, sm, offset, config.first_input_pin, num_switches);
+  printf("Configured switches program in sm %u offset %u\n", sm, offset);
+
+  irq_add_shared_handler(PIO0_IRQ_0, switches_irq, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+  pio_set_irq0_source_enabled(pio0, pio_get_rx_fifo_not_empty_interrupt_source(sm), true);
+  irq_set_enabled(PIO0_IRQ_0, true);
+}
+
+bool switches_pop_event(const HWConfigSwitches& config, SwitchEvent& event)
+{
+  return switches_events.read({reinterpret_cast<uint8_t*>(&event), sizeof(event)}) == sizeof(event);
+}
+
+// Leds: a frame goes out as a single DMA transfer into the ws2812b FIFO.
+// The strip only latches it after the line has been low for a while, so an
+// alarm set for the frame time plus that latch marks the LEDs free again.
+static constexpr uint32_t kLedWordUs = 30;     // 24 bits at 800 kHz
+static constexpr uint32_t kLedLatchUs = 300;   // newer WS2812B need > 280 us
+static uint leds_dma;
+static volatile bool leds_is_busy;
+
+void leds_init(const HWConfigLeds& config)
+{
+  const uint sm = config.state_machine_id;
+  uint offset = pio_add_program(pio0, &ws2812b_program);
+  ws2812b_program_init(pio0, sm, offset, config.data_pin);
+
+  leds_dma = dma_claim_unused_channel(true);
+  dma_channel_config dma_config = dma_channel_get_default_config(leds_dma);
+  channel_config_set_transfer_data_size(&dma_config, DMA_SIZE_32);
+  channel_config_set_read_increment(&dma_config, true);
+  channel_config_set_write_increment(&dma_config, false);
+  channel_config_set_dreq(&dma_config, pio_get_dreq(pio0, sm, true));
+  dma_channel_configure(leds_dma, &dma_config, &pio0->txf[sm], nullptr, 0, false);
+  printf("Configured ws2812b program in sm %u offset %u\n", sm, offset);
+}
+
+static int64_t leds_latched(alarm_id_t, void*)
+{
+  leds_is_busy = false;
+  return 0;
+}
+
+bool leds_busy()
+{
+  return leds_is_busy;
+}
+
+void leds_refresh(const HWConfigLeds& config, const uint32_t* leds, size_t num_leds)
+{
+  leds_is_busy = true;
+  dma_channel_transfer_from_buffer_now(leds_dma, leds, num_leds);
+  if (add_alarm_in_us(num_leds * kLedWordUs + kLedLatchUs, leds_latched, nullptr, true) < 0) {
+    // No alarm slot: better a short latch than LEDs that never update again
+    leds_is_busy = false;
+  }
+}
+
+// MIDI clock: the alarm callback sends each 0xF8 itself, as a single USB MIDI
+// packet, so a tick leaves when it's due rather than when the loop comes
+// round. Only if the alarm lands while the loop is inside TinyUSB is the tick
+// deferred to usb_unlock(), which sends it on the way out: the lateness is
+// then bounded by the longest locked call, not by a whole loop pass. Each
+// alarm is rescheduled from when the previous one was due, spreading the
+// quarter note's remainder over the 24 ticks, so the tick times never drift
+// with IRQ latency or rounding. The alarm pool runs on core 0, like the loop,
+// so disabling interrupts is all the loop needs to share this state.
+static alarm_id_t midi_clock_alarm;
+static uint32_t midi_clock_quarter_us;
+static uint32_t midi_clock_remainder;
+static uint64_t midi_clock_due_us;            // of the latest tick
+static std::atomic<uint32_t> midi_clock_due;
+static uint32_t midi_clock_taken;
+static volatile uint32_t midi_clock_deferred;
+static uint64_t midi_clock_deferred_us;       // of the oldest deferred tick
+static MidiClockStats midi_clock_stats;
+static volatile uint32_t usb_lock_depth;
+
+static uint32_t midi_clock_next_interval()
+{
+  midi_clock_remainder += midi_clock_quarter_us;
+  const uint32_t interval = midi_clock_remainder / kMidiClockPpq;
+  midi_clock_remainder %= kMidiClockPpq;
+  return interval;
+}
+
+// With interrupts off, or from the alarm IRQ
+static void midi_clock_send(uint32_t count, uint64_t due_us)
+{
+  const uint32_t late_us = uint32_t(time_us_64() - due_us);
+  midi_clock_stats.late_max_us = std::max(midi_clock_stats.late_max_us, late_us);
+  if (!tud_midi_mounted()) {
+    return;
+  }
+  // Cable 0, code index 0xF: a single byte message, so it can go between
+  // the packets of a SysEx the loop is streaming
+  static const uint8_t kPacket[4] = {0x0F, 0xF8, 0x00, 0x00};
+  for (; count > 0; --count) {
+    tud_midi_packet_write(kPacket);
+  }
+}
+
+static void midi_clock_tick()
+{
+  midi_clock_due.fetch_add(1, std::memory_order_relaxed);
+  ++midi_clock_stats.ticks;
+  if (usb_lock_depth == 0) {
+    midi_clock_send(1, midi_clock_due_us);
+    return;
+  }
+  if (midi_clock_deferred++ == 0) {
+    midi_clock_deferred_us = midi_clock_due_us;
+  }
+  ++midi_clock_stats.deferred;
+}
+
+static int64_t midi_clock_callback(alarm_id_t, void*)
+{
+  midi_clock_tick();
+  const uint32_t interval = midi_clock_next_interval();
+  midi_clock_due_us += interval;
+  // Negative: relative to the time this alarm was scheduled for
+  return -int64_t(interval);
+}
+
+void midi_clock_start(uint32_t quarter_us)
+{
+  midi_clock_stop();
+  midi_clock_quarter_us = quarter_us;
+  midi_clock_remainder = 0;
+  const uint32_t status = save_and_disable_interrupts();
+  // The first tick goes out right away, on the tap
+  midi_clock_due_us = time_us_64();
+  midi_clock_tick();
+  restore_interrupts(status);
+  const uint32_t interval = midi_clock_next_interval();
+  midi_clock_due_us += interval;
+  midi_clock_alarm = add_alarm_in_us(interval, midi_clock_callback, nullptr, true);
+}
+
+void midi_clock_stop()
+{
+  if (midi_clock_alarm > 0) {
+    cancel_alarm(midi_clock_alarm);
+    midi_clock_alarm = 0;
+  }
+}
+
+uint32_t midi_clock_ticks()
+{
+  const uint32_t due = midi_clock_due.load(std::memory_order_relaxed);
+  const uint32_t ticks = due - midi_clock_taken;
+  midi_clock_taken = due;
+  return ticks;
+}
+
+MidiClockStats midi_clock_take_stats()
+{
+  const uint32_t status = save_and_disable_interrupts();
+  const MidiClockStats stats = midi_clock_stats;
+  midi_clock_stats = {};
+  restore_interrupts(status);
+  return stats;
+}
+
+void usb_lock()
+{
+  usb_lock_depth = usb_lock_depth + 1;
+}
+
+void usb_unlock()
+{
+  for (;;) {
+    const uint32_t status = save_and_disable_interrupts();
+    const uint32_t count = (usb_lock_depth == 1) ? midi_clock_deferred : 0;
+    if (count == 0) {
+      usb_lock_depth = usb_lock_depth - 1;
+      restore_interrupts(status);
+      return;
+    }
+    // A few packet writes with interrupts off; a tick falling due meanwhile
+    // is deferred again and sent on the next time round
+    midi_clock_deferred = 0;
+    midi_clock_send(count, midi_clock_deferred_us);
+    restore_interrupts(status);
+  }
+}
+
+// Expression: the ADC free-runs at kExpressionSampleRate and a DMA channel
+// streams its FIFO into a ring, so sampling never depends on the main loop.
+// The ring holds 64 ms of samples, far more than any loop iteration takes.
+static constexpr uint32_t kExpressionRingBits = 10;
+static constexpr size_t kExpressionRingSize = (1 << kExpressionRingBits) / sizeof(uint16_t);
+alignas(1 << kExpressionRingBits) static uint16_t expression_ring[kExpressionRingSize];
+static uint expression_dma;
+static size_t expression_tail;
+
+static void expression_dma_start()
+{
+  dma_channel_set_trans_count(expression_dma, UINT32_MAX, true);
+}
+
+void expression_init(const HWConfigExpression& config)
+{
+  adc_init();
+  // Make sure GPIO is high-impedance, no pullups etc
+  adc_gpio_init(config.adc_pin);
+  // Select ADC input (starts at GPIO26)
+  adc_select_input(config.adc_pin - 26);
+  adc_fifo_setup(true, true, 1, false, false);
+  // One conversion takes 96 cycles of the 48 MHz ADC clock; the divider
+  // stretches the period to the sample rate
+  adc_set_clkdiv(48000000.0f / kExpressionSampleRate - 1);
+
+  expression_dma = dma_claim_unused_channel(true);
+  dma_channel_config dma_config = dma_channel_get_default_config(expression_dma);
+  channel_config_set_transfer_data_size(&dma_config, DMA_SIZE_16);
+  channel_config_set_read_increment(&dma_config, false);
+  channel_config_set_write_increment(&dma_config, true);
+  channel_config_set_ring(&dma_config, true, kExpressionRingBits);
+  channel_config_set_dreq(&dma_config, DREQ_ADC);
+  dma_channel_configure(expression_dma, &dma_config, expression_ring, &adc_hw->fifo, UINT32_MAX, true);
+  expression_tail = 0;
+  adc_run(true);
+
+  // Initialize the GPIO
+  gpio_init(config.connected_pin);
+
+  // Set as input
+  gpio_set_dir(config.connected_pin, GPIO_IN);
+
+  // Enable the internal pull-up resistor
+  gpio_pull_up(config.connected_pin);
+}
+
+size_t expression_read(const HWConfigExpression& config, uint16_t* samples, size_t max)
+{
+  // All ones is endless mode on the RP2350; on the RP2040 it lasts days, but
+  // re-arm if it ever runs out
+  if (!dma_channel_is_busy(expression_dma)) {
+    expression_dma_start();
+  }
+
+  auto write_addr = reinterpret_cast<const uint16_t*>(dma_hw->ch[expression_dma].write_addr);
+  const size_t head = size_t(write_addr - expression_ring) % kExpressionRingSize;
+  size_t count = std::min((head - expression_tail) % kExpressionRingSize, max);
+  for (size_t i = 0; i < count; ++i) {
+    samples[i] = expression_ring[expression_tail];
+    expression_tail = (expression_tail + 1) % kExpressionRingSize;
+  }
+  return count;
+}
+
 uint HALDisplay::dma;
 uint8_t HALDisplay::cs_pin;
 uint8_t HALDisplay::reset_pin;
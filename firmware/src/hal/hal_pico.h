@@ -3,6 +3,7 @@
 #define HAL_PICO
 
 #include "ws2812b.pio.h"
+#include "switches.pio.h"
 #include "config.h"
 
 extern "C" {
@@ -21,6 +22,7 @@ extern "C" {
 #include <pico/stdio.h>
 #include <pico/stdio/driver.h>
 #include <pico/time.h>
+#include <pico/multicore.h>
 #ifdef CYW43_WL_GPIO_LED_PIN
 #include <pico/cyw43_arch.h>
 #endif
@@ -32,13 +34,23 @@ namespace tocata {
 
 // System
 
-static inline void idle_loop() {}
 static inline uint32_t millis() { return to_ms_since_boot(get_absolute_time()); }
 static inline uint32_t micros() { return time_us_32(); }
+// Sleeps in WFE until the micros() deadline or any interrupt. An IRQ taken
+// after the caller last looked still sets the event flag, so it can't be missed.
+static inline void idle_until(uint32_t deadline)
+{
+  const int32_t delay = static_cast<int32_t>(deadline - micros());
+  if (delay > 0) {
+    best_effort_wfe_or_timeout(make_timeout_time_us(delay));
+  }
+}
 static inline void sleep_ms(uint32_t ms) { ::sleep_ms(ms); }
-static inline void board_reset() { watchdog_enable(50, 0); }
+void flash_flush();
+static inline void board_reset() { flash_flush(); watchdog_enable(50, 0); }
 static inline void board_program() 
 {
+  flash_flush();
   add_alarm_in_ms(50, [](alarm_id_t, void *) {
     reset_usb_boot(0, 1);
     return 0LL;
@@ -64,10 +76,21 @@ static constexpr uint32_t kFlashPartitionOffset = 512 * 1024;
 static constexpr uint32_t kFlashSize = 2 * 1024 * 1024;
 #endif
 
+#if !MEMFLASH
+// Erase and program run on core 1 so core 0 keeps scanning switches and
+// serving USB while a sector is being erased. See hal_pico.cpp.
+void flash_worker_init();
+void flash_worker_read(uint32_t flash_offs, void *dst, size_t count);
+void flash_worker_program(uint32_t flash_offs, const uint8_t *data, size_t count);
+void flash_worker_erase(uint32_t flash_offs, size_t count);
+#endif
+
 static inline void flash_init()
 {
 #if MEMFLASH
 memset(MemFlash, 0xFF, kFlashSize);
+#else
+flash_worker_init();
 #endif
 }
 
@@ -78,8 +101,7 @@ static inline void flash_read(uint32_t flash_offs, void *dst, size_t count)
     printf("flash_read 0x%08X %u bytes\n", flash_offs, (uint32_t)count);
     memcpy(dst, MemFlash + flash_offs, count);
 #else
-    const uint8_t* flash = reinterpret_cast<const uint8_t*>(XIP_BASE);
-    memcpy(dst, flash + flash_offs, count);
+    flash_worker_read(flash_offs, dst, count);
 #endif
 }
 
@@ -95,7 +117,7 @@ static inline void flash_write(uint32_t flash_offs, const void *data, size_t cou
         MemFlash[flash_offs + i] &= static_cast<const uint8_t*>(data)[i];
     }
 #else
-    flash_range_program(flash_offs, static_cast<const uint8_t*>(data), count);
+    flash_worker_program(flash_offs, static_cast<const uint8_t*>(data), count);
 #endif
 }
 
@@ -108,20 +130,16 @@ static inline void flash_erase(uint32_t flash_offs, size_t count)
     printf("flash_erase 0x%08X %u bytes\n", flash_offs, (uint32_t)count);
     memset(MemFlash + flash_offs, 0xFF, count);
 #else
-    flash_range_erase(flash_offs, count);
+    flash_worker_erase(flash_offs, count);
 #endif
 }
 
 // Switches
 
-static inline void switches_init(const HWConfigSwitches& config, uint8_t num_switches)
-{
-    for (auto pin = config.first_input_pin; pin < (config.first_input_pin + num_switches); ++pin) {
-        gpio_init(pin);
-        gpio_set_dir(pin, GPIO_IN);
-        gpio_pull_up(pin);
-    }
-}
+void switches_init(const HWConfigSwitches& config, uint8_t num_switches);
+
+// Oldest debounced edge not yet handed out, if any
+bool switches_pop_event(const HWConfigSwitches& config, SwitchEvent& event);
 
 static inline uint32_t switches_value(const HWConfigSwitches& config)
 {
@@ -130,63 +148,36 @@ static inline uint32_t switches_value(const HWConfigSwitches& config)
 
 // Expression
 
-static inline void expression_init(const HWConfigExpression& config) 
-{
-    adc_init();
-    // Make sure GPIO is high-impedance, no pullups etc
-    adc_gpio_init(config.adc_pin);
-    // Select ADC input (starts at GPIO26)
-    adc_select_input(config.adc_pin - 26);
-
-    // Initialize the GPIO
-    gpio_init(config.connected_pin);
-
-    // Set as input
-    gpio_set_dir(config.connected_pin, GPIO_IN);
-
-    // Enable the internal pull-up resistor
-    gpio_pull_up(config.connected_pin);
-}
+void expression_init(const HWConfigExpression& config);
 
 static inline bool expression_is_connected(const HWConfigExpression& config)
 {
     return gpio_get(config.connected_pin);
 }
 
-static inline uint16_t expression_read(const HWConfigExpression& config)
-{
-    if (!expression_is_connected(config))
-    {
-        return 0;
-    }
-    return adc_read();
-}
+// Copies out the samples converted since the last call, oldest first
+size_t expression_read(const HWConfigExpression& config, uint16_t* samples, size_t max);
+
+// MIDI clock: a hardware alarm keeps the tick times and sends each 0xF8 to
+// USB from its IRQ, whatever the loop does
+
+// (Re)starts the clock at quarter_us per quarter note, from now
+void midi_clock_start(uint32_t quarter_us);
+void midi_clock_stop();
+// Ticks that fell due since the last call, already sent to USB
+uint32_t midi_clock_ticks();
+MidiClockStats midi_clock_take_stats();
 
 // Leds
 
-static inline void leds_init(const HWConfigLeds& config)
-{
-    uint offset = pio_add_program(pio0, &ws2812b_program);
-    ws2812b_program_init(pio0, config.state_machine_id, offset, config.data_pin);
-    printf("Configured ws2812b program in sm %u offset %u\n", config.state_machine_id, offset);
-}
+void leds_init(const HWConfigLeds& config);
 
-static inline void leds_refresh(const HWConfigLeds& config, uint32_t* leds, size_t num_leds)
-{
-    for (size_t led = 0; led < num_leds; ++led)
-    {
-        const uint32_t led_value = leds[led];
-        pio_sm_put_blocking(pio0, config.state_machine_id, led_value);
-    }
+// A frame is still being sent or latched; leds_refresh() must wait
+bool leds_busy();
 
-    printf("Leds update sm %u:", config.state_machine_id);
-    for (size_t led = 0; led < num_leds; ++led)
-    {
-        const uint32_t led_value = leds[led];
-        printf(" %08X", led_value);
-    }
-    printf("\n");
-}
+// Starts sending the frame and returns right away. `leds` is read while the
+// frame goes out, so it has to outlive the transfer.
+void leds_refresh(const HWConfigLeds& config, const uint32_t* leds, size_t num_leds);
 
 // I2C
 
@@ -312,12 +303,27 @@ static inline void board_led_enable(bool enabled)
 
 void usb_init();
 
-static inline void usb_run() { tud_task(); }
+// TinyUSB isn't reentrant and the MIDI clock alarm writes to it from its IRQ,
+// so every call the loop makes into it goes between these two
+void usb_lock();
+void usb_unlock();
 
+static inline void usb_run()
+{
+  usb_lock();
+  tud_task();
+  usb_unlock();
+}
 
 static inline size_t usb_midi_write(const unsigned char* message, size_t size) 
 {    
-  return size == 0 ? 0 : tud_midi_stream_write(0, message, size);
+  if (size == 0) {
+    return 0;
+  }
+  usb_lock();
+  const size_t written = tud_midi_stream_write(0, message, size);
+  usb_unlock();
+  return written;
 }
 
 static inline void usb_midi_write(uint8_t val1, uint8_t val2) 
@@ -332,6 +338,11 @@ static inline void usb_midi_write(uint8_t val1, uint8_t val2, uint8_t val3)
   usb_midi_write(message, sizeof(message));
 }
 
+static inline bool usb_midi_connected()
+{
+  return tud_midi_mounted();
+}
+
 static inline uint32_t usb_midi_available()
 {
   return tud_midi_available();
@@ -339,7 +350,10 @@ static inline uint32_t usb_midi_available()
 
 static inline uint32_t usb_midi_stream_read(void* buffer, uint32_t bufsize)
 {
-  return tud_midi_stream_read(buffer, bufsize);
+  usb_lock();
+  const uint32_t read = tud_midi_stream_read(buffer, bufsize);
+  usb_unlock();
+  return read;
 }
 
 constexpr bool is_pedal_long() {
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "hal.h"
+#include "display_sim.h"
+#include "flash_sim.h"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Control side of the headless HAL (hal_headless.cpp, built with HAL_HEADLESS).
+// Nothing here runs in real time: the driver schedules input on the virtual
+// clock, runs the firmware until some point of that clock and then inspects
+// what came out. The same script always produces the same output.
+namespace tocata::headless {
+
+// Virtual clock, in microseconds since boot
+uint64_t now();
+// Moves the clock forward; never backwards
+void advanceTo(uint64_t time_us);
+// Virtual time every main loop pass costs (usb_run). Has to be non zero so the
+// firmware's busy-wait loops terminate.
+void setPassCost(uint32_t us);
+
+// Long (SSD1322, 8 switches) or short (SH1106, 6 switches) pedal. Read once by
+// the firmware, so it has to be set before the Controller is built.
+void setPedalLong(bool is_long);
+
+// Scripted input. Events take effect when the clock reaches `time_us`, and
+// idle_until wakes up for them like it would for an interrupt.
+void setSwitches(uint64_t time_us, uint32_t value);
+void setExpression(uint64_t time_us, uint16_t raw);
+void setExpressionConnected(bool connected);
+void sendMidi(uint64_t time_us, std::span<const uint8_t> message);
+// Time of the next scripted input still pending, or UINT64_MAX
+uint64_t nextInput();
+
+// Captured output
+struct MidiMessage
+{
+    uint64_t time_us;
+    std::vector<uint8_t> bytes;
+};
+
+const std::vector<MidiMessage>& midiOut();
+void clearMidiOut();
+// Latest colors sent to the leds, in the firmware's GRB word format
+std::span<const uint32_t> leds();
+
+// The simulated controller the display driver talks to
+DisplaySim& display();
+// Bytes sent over SPI/I2C to the display since boot
+uint64_t displayBytes();
+// Decodes the display RAM into one byte per pixel, 0 or 1, row by row
+void copyFramebuffer(std::vector<uint8_t>& pixels);
+
+// Program and erase operations take as long as on the board: off by default,
+// so flash traffic doesn't shift the timing of everything else
+void setFlashLatency(bool enabled);
+// Wear and traffic counters of the simulated flash
+const FlashSim& flashSim();
+// Flash starts fully erased; these copy a whole image in or out, e.g. a
+// /tmp/tocata_flash from the SDL build
+bool loadFlash(const char* path);
+bool saveFlash(const char* path);
+
+}
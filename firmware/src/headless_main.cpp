@@ -0,0 +1,226 @@
+#include "controller.h"
+#include "hal.h"
+#include "headless.h"
+#include "headless_seed.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Runs a scripted performance against the real Controller on the headless HAL,
+// as many times as asked, and reports how the firmware responded in virtual
+// time and how long the host took to simulate it. Virtual figures are exactly
+// reproducible, so any change in them is a change in the firmware.
+//
+//   TocataPedalHeadless [performances] [flash image]
+//                       [--max-latency-us us] [--max-expression-us us]
+//
+// Without an image, flash is seeded (see headless_seed.h) so every input has
+// something to answer. An image (e.g. /tmp/tocata_flash from the SDL
+// build) is used as is. With a --max option, any switch press or identity
+// request left silent or slower than --max-latency-us, or expression change
+// slower than --max-expression-us, makes the run fail. Incoming program
+// changes are reported only: the pedal follows them without answering.
+
+using namespace tocata;
+
+namespace {
+
+// Enough virtual time for every reaction to an input to come out
+constexpr uint64_t kStepUs = 50000;
+constexpr uint64_t kHoldUs = 80000;
+constexpr uint8_t kMidiChannel = 0;
+
+struct Latency
+{
+    uint64_t total_us = 0;
+    uint64_t max_us = 0;
+    uint32_t count = 0;   // inputs that produced MIDI
+    uint32_t silent = 0;  // inputs that didn't
+
+    void add(uint64_t us)
+    {
+        total_us += us;
+        max_us = std::max(max_us, us);
+        ++count;
+    }
+    uint64_t mean() const { return count ? total_us / count : 0; }
+};
+
+void runUntil(Controller& controller, uint64_t end_us)
+{
+    while (headless::now() < end_us)
+    {
+        controller.run();
+        // deadline() is in wrapping micros(), so compare distances rather
+        // than absolute times
+        const uint32_t now = micros();
+        const int32_t to_deadline = static_cast<int32_t>(controller.deadline() - now);
+        const int32_t to_end = int32_t(std::min<uint64_t>(end_us - headless::now(), INT32_MAX));
+        idle_until(now + uint32_t(std::max(0, std::min(to_deadline, to_end))));
+    }
+}
+
+// Lets one input play out and charges the time to its first MIDI answer
+void measure(Controller& controller, uint64_t input_us, Latency& latency)
+{
+    const size_t first = headless::midiOut().size();
+    runUntil(controller, input_us + kStepUs);
+    const auto& out = headless::midiOut();
+    if (out.size() > first)
+    {
+        latency.add(out[first].time_us - input_us);
+    }
+    else
+    {
+        ++latency.silent;
+    }
+}
+
+void press(Controller& controller, uint8_t sw, Latency& latency)
+{
+    const uint64_t start = headless::now();
+    headless::setSwitches(start, 1u << sw);
+    measure(controller, start, latency);
+    headless::setSwitches(start + kHoldUs, 0);
+    runUntil(controller, start + kHoldUs + kStepUs);
+}
+
+void programChange(Controller& controller, uint8_t program, Latency& latency)
+{
+    const uint64_t start = headless::now();
+    const uint8_t message[] = {uint8_t(0xC0 | kMidiChannel), program};
+    headless::sendMidi(start, message);
+    measure(controller, start, latency);
+}
+
+void identityRequest(Controller& controller, Latency& latency)
+{
+    const uint64_t start = headless::now();
+    const uint8_t message[] = {0xF0, 0x7E, 0x7F, 0x06, 0x01, 0xF7};
+    headless::sendMidi(start, message);
+    measure(controller, start, latency);
+}
+
+void expressionSweep(Controller& controller, Latency& latency)
+{
+    constexpr uint16_t kSteps = 16;
+    for (uint16_t step = 0; step <= kSteps; ++step)
+    {
+        const uint64_t start = headless::now();
+        headless::setExpression(start, uint16_t(step * 4095 / kSteps));
+        // The expression isn't an interrupt source, so only the firmware's own
+        // polling picks it up: measured from the scripted change all the same
+        measure(controller, start, latency);
+    }
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t performances = 100;
+    const char* image = nullptr;
+    uint64_t max_latency_us = UINT64_MAX;
+    uint64_t max_expression_us = UINT64_MAX;
+    for (int arg = 1, position = 0; arg < argc; ++arg)
+    {
+        if (!strcmp(argv[arg], "--max-latency-us") && arg + 1 < argc)
+        {
+            max_latency_us = std::strtoull(argv[++arg], nullptr, 10);
+        }
+        else if (!strcmp(argv[arg], "--max-expression-us") && arg + 1 < argc)
+        {
+            max_expression_us = std::strtoull(argv[++arg], nullptr, 10);
+        }
+        else if (position++ == 0)
+        {
+            performances = uint32_t(std::strtoul(argv[arg], nullptr, 10));
+        }
+        else
+        {
+            image = argv[arg];
+        }
+    }
+    if (image && !headless::loadFlash(image))
+    {
+        printf("Cannot load flash image %s\n", image);
+        return 1;
+    }
+    if (!image)
+    {
+        // The Controller initialises storage again and keeps what's there
+        Storage::init();
+        headless::seedFlash();
+    }
+
+    static HWConfig hw_config = {
+        .switches = {
+            .map = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, },
+        },
+        .leds = {
+            .map = { 0, 1, 2, 3, 4, 5, 6, 7, },
+        },
+    };
+
+    headless::setExpressionConnected(true);
+    // Toe down, so the first sweep's heel down step is a change as well
+    headless::setExpression(0, 4095);
+    static Controller controller{hw_config};
+    controller.init();
+    runUntil(controller, headless::now() + kStepUs);
+
+    const uint64_t boot_us = headless::now();
+    const uint64_t boot_display_bytes = headless::displayBytes();
+    headless::clearMidiOut();
+
+    Latency switches;
+    Latency programs;
+    Latency expression;
+    Latency identity;
+    size_t midi_messages = 0;
+
+    const auto wall_start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < performances; ++i)
+    {
+        for (uint8_t sw = 0; sw < 4; ++sw)
+        {
+            press(controller, sw, switches);
+        }
+        for (uint8_t program = 1; program <= 3; ++program)
+        {
+            programChange(controller, program, programs);
+        }
+        programChange(controller, 0, programs);
+        expressionSweep(controller, expression);
+        identityRequest(controller, identity);
+
+        // Keep memory flat over long runs
+        midi_messages += headless::midiOut().size();
+        headless::clearMidiOut();
+    }
+    const std::chrono::duration<double> wall = std::chrono::steady_clock::now() - wall_start;
+
+    const double virtual_s = double(headless::now() - boot_us) / 1e6;
+    printf("performances %u in %.3f s wall, %.1f per second\n",
+        performances, wall.count(), wall.count() > 0 ? performances / wall.count() : 0.0);
+    printf("virtual %.3f s, %.0fx real time\n", virtual_s, wall.count() > 0 ? virtual_s / wall.count() : 0.0);
+    printf("midi out %zu messages, display %llu bytes\n",
+        midi_messages, (unsigned long long)(headless::displayBytes() - boot_display_bytes));
+    bool passed = true;
+    auto report = [&passed](const char* name, const Latency& latency, uint64_t max_us) {
+        const bool within = latency.max_us <= max_us && (max_us == UINT64_MAX || latency.silent == 0);
+        printf("latency %-10s mean %6llu us  max %6llu us  (%u answered, %u silent)%s\n", name,
+            (unsigned long long)latency.mean(), (unsigned long long)latency.max_us,
+            latency.count, latency.silent, within ? "" : "  FAILED");
+        passed = passed && within;
+    };
+    report("switch", switches, max_latency_us);
+    report("program", programs, UINT64_MAX);
+    report("expression", expression, max_expression_us);
+    report("identity", identity, max_latency_us);
+
+    return passed ? 0 : 1;
+}
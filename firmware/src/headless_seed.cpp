@@ -0,0 +1,119 @@
+#include "headless_seed.h"
+#include "config.h"
+#include "hal.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace tocata::headless {
+
+namespace {
+
+// ConfigProtocol carries programs and setlists as their own packed layouts
+// (SET_PROGRAM, SET_SETLIST), so the seed is written in that layout too
+struct ActionBytes
+{
+    uint8_t channel_and_type;
+    uint8_t values[2];
+} __attribute__((packed));
+
+struct ActionsBytes
+{
+    uint8_t num_actions;
+    ActionBytes actions[Actions::kMaxActions];
+} __attribute__((packed));
+
+struct FootswitchBytes
+{
+    ActionsBytes on_actions;
+    ActionsBytes off_actions;
+    char name[Program::Footswitch::kMaxNameSize + 1];
+    uint8_t color;
+    uint8_t enabled;
+    uint8_t mode;
+} __attribute__((packed));
+
+struct ProgramBytes
+{
+    char name[Program::kMaxNameLength + 1];
+    uint8_t num_switches;
+    FootswitchBytes switches[Program::kNumSwitches];
+    ActionsBytes actions;
+    uint8_t channel_and_mode;
+    uint8_t expression;
+} __attribute__((packed));
+
+struct SetlistBytes
+{
+    char name[Program::kMaxNameLength + 1];
+    uint8_t num_programs;
+    uint8_t programs[Program::kMaxPrograms];
+} __attribute__((packed));
+
+static_assert(sizeof(ProgramBytes) == sizeof(Program));
+static_assert(sizeof(SetlistBytes) == sizeof(Setlist));
+
+// Actions on the device-wide channel, like the configurator's default
+ActionsBytes oneAction(Actions::Action::Type type, uint8_t value1, uint8_t value2)
+{
+    ActionsBytes actions{};
+    actions.num_actions = 1;
+    actions.actions[0] = {uint8_t(type | kGlobalChannelMask), {value1, value2}};
+    return actions;
+}
+
+}
+
+void seedFlash()
+{
+    // An empty config file reads back as a zero expression calibration,
+    // which pins the expression at its maximum
+    Config config;
+    config.expression().setMinRaw(Config::ExpressionConfig::kDefaultMinRaw);
+    config.expression().setMaxRaw(Config::ExpressionConfig::kDefaultMaxRaw);
+    config.save();
+
+    // A program mode switch turns off the two-switch gesture and the
+    // detection delay that comes with it. On the pedal's last switch, which
+    // the latency performance never presses.
+    const uint8_t program_switch = is_pedal_long() ? 7 : 5;
+    for (uint8_t id = 0; id < kSeededPrograms; ++id)
+    {
+        ProgramBytes program{};
+        if (id == kLongNameProgram)
+        {
+            snprintf(program.name, sizeof(program.name), "Program %u, too long to fit", id + 1);
+        }
+        else
+        {
+            snprintf(program.name, sizeof(program.name), "Program %u", id + 1);
+        }
+        program.num_switches = Program::kNumSwitches;
+        program.actions = oneAction(Actions::Action::kProgramChange, id, 0);
+        for (uint8_t sw = 0; sw < Program::kNumSwitches; ++sw)
+        {
+            auto& footswitch = program.switches[sw];
+            footswitch.on_actions = oneAction(Actions::Action::kControlChange, uint8_t(20 + sw), 127);
+            footswitch.off_actions = oneAction(Actions::Action::kControlChange, uint8_t(20 + sw), 0);
+            snprintf(footswitch.name, sizeof(footswitch.name), "FX %u", sw + 1);
+            footswitch.color = kBlue + sw % (kWhite - kBlue + 1);
+            footswitch.enabled = true;
+            footswitch.mode = Program::Footswitch::kStomp;
+        }
+        program.switches[program_switch].mode = Program::Footswitch::kProgram;
+        program.channel_and_mode = kGlobalChannelMask | Program::kDefault;
+        program.expression = 11;
+        reinterpret_cast<const Program&>(program).save(id);
+    }
+
+    SetlistBytes setlist{};
+    strcpy(setlist.name, "Seeded");
+    setlist.num_programs = kSeededPrograms;
+    for (uint8_t pos = 0; pos < kSeededPrograms; ++pos)
+    {
+        setlist.programs[pos] = uint8_t(kSeededPrograms - 1 - pos);
+    }
+    reinterpret_cast<const Setlist&>(setlist).save(1);
+}
+
+}
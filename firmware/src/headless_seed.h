@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+// Flash contents for headless runs that don't start from an image: a
+// calibrated config, a few programs whose switches and expression all send
+// MIDI, and a setlist, so every input has something to answer and every
+// screen something to show. Written through the same Config, Program and
+// Setlist code a configurator's writes end up in.
+namespace tocata::headless {
+
+constexpr uint8_t kSeededPrograms = 4;
+// The last seeded program's name is too long for either display, so showing
+// it scrolls
+constexpr uint8_t kLongNameProgram = kSeededPrograms - 1;
+
+// Needs Storage initialised and the pedal size settled: the programs' program
+// mode switch is the pedal's last one
+void seedFlash();
+
+}
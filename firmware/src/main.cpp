@@ -72,7 +72,7 @@ int main()
   while (true)
   {
     controller.run();
-    tocata::idle_loop();
+    tocata::idle_until(controller.deadline());
   }
   
   return 0;
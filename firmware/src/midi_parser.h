@@ -0,0 +1,111 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <cstdint>
+
+#include "midi_sysex.h"
+
+namespace tocata {
+
+// Streaming MIDI 1.0 byte parser. Bytes may arrive split at any point, and
+// every complete message is handed out with its status byte, so receivers
+// never have to re-scan: running status is expanded, realtime bytes (clock,
+// start, stop...) are passed through as single byte messages at the point
+// they arrive, even in the middle of a SysEx, and a SysEx is only delivered
+// once its F7 is seen.
+class MidiParser {
+public:
+    static constexpr size_t kMaxMessageSize = kMidiSysExMaxSize;
+
+    template <typename Handler>
+    void parse(std::span<const uint8_t> input, Handler&& handler) {
+        for (auto b : input) {
+            if (b >= 0xF8) {
+                handler(std::span<const uint8_t>{&b, 1});
+            } else if (b & 0x80) {
+                status(b, handler);
+            } else if (_sysex) {
+                if (_size < _message.size()) {
+                    _message[_size++] = b;
+                } else {
+                    _overflow = true;
+                }
+            } else if (_expected > 0) {
+                _message[_size++] = b;
+                if (_size == _expected) {
+                    handler(std::span<const uint8_t>{_message.data(), _size});
+                    if (_message[0] < 0xF0) {
+                        // Running status: the next data byte starts a new message
+                        _size = 1;
+                    } else {
+                        // System common messages cancel running status
+                        reset();
+                    }
+                }
+            }
+        }
+    }
+
+    void reset() {
+        _size = 0;
+        _expected = 0;
+        _sysex = false;
+        _overflow = false;
+    }
+
+private:
+    template <typename Handler>
+    void status(uint8_t b, Handler& handler) {
+        if (b == 0xF7) {
+            if (_sysex && !_overflow && _size < _message.size()) {
+                _message[_size++] = b;
+                handler(std::span<const uint8_t>{_message.data(), _size});
+            }
+            reset();
+            return;
+        }
+
+        // Any other status ends an unterminated SysEx, which is dropped
+        reset();
+        _message[_size++] = b;
+        if (b == 0xF0) {
+            _sysex = true;
+            return;
+        }
+
+        _expected = 1 + dataBytes(b);
+        if (_expected == 1) {
+            handler(std::span<const uint8_t>{_message.data(), _size});
+            reset();
+        }
+    }
+
+    static constexpr size_t dataBytes(uint8_t status) {
+        switch (status & 0xF0) {
+            case 0xC0:
+            case 0xD0:
+                return 1;
+            case 0xF0:
+                switch (status) {
+                    case 0xF1:
+                    case 0xF3:
+                        return 1;
+                    case 0xF2:
+                        return 2;
+                    default:
+                        return 0;
+                }
+            default:
+                return 2;
+        }
+    }
+
+    std::array<uint8_t, kMaxMessageSize> _message;
+    size_t _size{0};
+    size_t _expected{0};
+    bool _sysex{false};
+    bool _overflow{false};
+};
+
+}
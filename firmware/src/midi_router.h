@@ -0,0 +1,238 @@
+#pragma once
+
+#include "midi_sender.h"
+
+#include <array>
+#include <algorithm>
+#include <cstdint>
+#include <span>
+
+namespace tocata {
+
+// Which messages a MidiRouter destination accepts
+struct MidiFilter {
+    enum Type : uint8_t {
+        kProgram = 1 << 0,
+        kControl = 1 << 1,
+        kSysEx = 1 << 2,
+        kRealtime = 1 << 3,     // clock and the other single byte F8..FF
+        kAll = kProgram | kControl | kSysEx | kRealtime,
+    };
+
+    uint16_t channels = 0xFFFF;     // one bit per MIDI channel
+    uint8_t types = kAll;
+
+    bool accepts(std::span<const uint8_t> message) const {
+        switch (message[0] & 0xF0) {
+            case 0xC0:
+                return (types & kProgram) && (channels & (1 << (message[0] & 0x0F)));
+            case 0xB0:
+                return (types & kControl) && (channels & (1 << (message[0] & 0x0F)));
+            case 0xF0:
+                if (message[0] >= 0xF8) {
+                    return types & kRealtime;
+                }
+                return (types & kSysEx) && message[0] == 0xF0;
+            default:
+                return false;
+        }
+    }
+};
+
+// Output fan-out. The Controller sends everything once through the router,
+// which encodes each message a single time and hands the same bytes to every
+// destination whose filter accepts it. Destinations are queued transports, so
+// this only enqueues: USB and Ethernet get the message at the same moment and
+// drain it at their own pace. Input still arrives per transport.
+//
+// Continuous controllers (the expression pedal) go through latest() instead:
+// only the newest value of each CC is kept, and each destination flushes them
+// from run() at most max_rate times a second. A sweep then costs a bounded
+// number of messages per transport, the final value always goes out, and
+// anything sent normally flushes what's pending first so order is kept.
+class MidiRouter : public MidiSender {
+public:
+    static constexpr size_t kMaxDestinations = 2;
+    static constexpr size_t kMaxCoalesced = 4;
+
+    using Filter = MidiFilter;
+
+    MidiRouter() = default;
+    // latest() refers back to this router
+    MidiRouter(const MidiRouter&) = delete;
+    MidiRouter& operator=(const MidiRouter&) = delete;
+
+    // max_rate is in flushes per second; 0 sends coalesced CCs right away
+    bool addDestination(MidiSender& sender, Filter filter = {}, uint32_t max_rate = 0) {
+        if (_num_destinations == kMaxDestinations) {
+            return false;
+        }
+        _destinations[_num_destinations++] = {.sender = &sender, .filter = filter, .interval = interval(max_rate)};
+        return true;
+    }
+
+    void setMaxRate(const MidiSender& sender, uint32_t max_rate) {
+        for (auto& destination : destinations()) {
+            if (destination.sender == &sender) {
+                destination.interval = interval(max_rate);
+            }
+        }
+    }
+
+    void setFilter(const MidiSender& sender, Filter filter) {
+        for (auto& destination : destinations()) {
+            if (destination.sender == &sender) {
+                destination.filter = filter;
+            }
+        }
+    }
+
+    void sendProgram(uint8_t channel, uint8_t program) override {
+        const uint8_t message[] = {uint8_t(0xC0 | (channel & 0x0F)), program};
+        sendMessage(message);
+    }
+
+    void sendControl(uint8_t channel, uint8_t control, uint8_t value) override {
+        const uint8_t message[] = {uint8_t(0xB0 | (channel & 0x0F)), control, value};
+        sendMessage(message);
+    }
+
+    void sendSysEx(std::span<const uint8_t> sysex) override {
+        sendMessage(sysex);
+    }
+
+    void sendMessage(std::span<const uint8_t> message) override {
+        for (auto& destination : destinations()) {
+            if (destination.filter.accepts(message)) {
+                destination.flush();
+                destination.sender->sendMessage(message);
+            }
+        }
+    }
+
+    // Control change that replaces any still pending one for the same CC
+    void sendControlLatest(uint8_t channel, uint8_t control, uint8_t value) {
+        const uint8_t message[] = {uint8_t(0xB0 | (channel & 0x0F)), control, value};
+        for (auto& destination : destinations()) {
+            if (!destination.filter.accepts(message)) {
+                continue;
+            }
+            if (destination.interval == 0 || !destination.coalesce(message)) {
+                destination.flush();
+                destination.sender->sendMessage(message);
+            }
+        }
+    }
+
+    // Flushes the destinations whose interval has elapsed; call it every loop
+    void run(uint32_t now) {
+        for (auto& destination : destinations()) {
+            // Unsigned difference: wrap safe, and a stale last_flush after a
+            // long idle can at worst delay the flush by one interval
+            if (destination.num_pending > 0 && now - destination.last_flush >= destination.interval) {
+                destination.flush();
+                destination.last_flush = now;
+            }
+        }
+    }
+
+    // When run() has coalesced CCs to flush, if any
+    bool nextFlush(uint32_t& deadline) const {
+        bool pending = false;
+        for (const auto& destination : destinations()) {
+            const uint32_t next = destination.last_flush + destination.interval;
+            if (destination.num_pending > 0 && (!pending || static_cast<int32_t>(next - deadline) < 0)) {
+                deadline = next;
+                pending = true;
+            }
+        }
+        return pending;
+    }
+
+    // A MidiSender view of the router whose control changes are coalesced,
+    // for code that sends through the MidiSender interface
+    MidiSender& latest() { return _latest; }
+
+    // Output only: requests are answered by the transport they came from
+    void setCallback(Callback) override {}
+
+    size_t pending() const override {
+        size_t pending = 0;
+        for (const auto& destination : destinations()) {
+            pending = std::max(pending, destination.sender->pending());
+        }
+        return pending;
+    }
+
+    size_t dropped() const override {
+        size_t dropped = 0;
+        for (const auto& destination : destinations()) {
+            dropped += destination.sender->dropped();
+        }
+        return dropped;
+    }
+
+private:
+    class Latest : public MidiSender {
+    public:
+        explicit Latest(MidiRouter& router) : _router(router) {}
+        void sendProgram(uint8_t channel, uint8_t program) override { _router.sendProgram(channel, program); }
+        void sendControl(uint8_t channel, uint8_t control, uint8_t value) override {
+            _router.sendControlLatest(channel, control, value);
+        }
+        void sendSysEx(std::span<const uint8_t> sysex) override { _router.sendSysEx(sysex); }
+        void sendMessage(std::span<const uint8_t> message) override { _router.sendMessage(message); }
+        void setCallback(Callback) override {}
+        size_t pending() const override { return _router.pending(); }
+        size_t dropped() const override { return _router.dropped(); }
+
+    private:
+        MidiRouter& _router;
+    };
+
+    struct Destination {
+        MidiSender* sender;
+        Filter filter;
+        uint32_t interval = 0;
+        uint32_t last_flush = 0;
+        // Pending CCs in the order of their last update, so a 14 bit MSB
+        // sent before its LSB still reaches the receiver first
+        std::array<std::array<uint8_t, 3>, kMaxCoalesced> pending{};
+        size_t num_pending = 0;
+
+        bool coalesce(std::span<const uint8_t> message) {
+            auto end = pending.begin() + num_pending;
+            auto found = std::find_if(pending.begin(), end, [&](const auto& cc) {
+                return cc[0] == message[0] && cc[1] == message[1];
+            });
+            if (found != end) {
+                std::rotate(found, found + 1, end);
+                --num_pending;
+            } else if (num_pending == kMaxCoalesced) {
+                return false;
+            }
+            std::copy_n(message.begin(), 3, pending[num_pending++].begin());
+            return true;
+        }
+
+        void flush() {
+            for (const auto& cc : std::span{pending.data(), num_pending}) {
+                sender->sendMessage(cc);
+            }
+            num_pending = 0;
+        }
+    };
+
+    static constexpr uint32_t interval(uint32_t max_rate) {
+        return max_rate == 0 ? 0 : 1000000 / max_rate;
+    }
+
+    std::span<Destination> destinations() { return {_destinations.data(), _num_destinations}; }
+    std::span<const Destination> destinations() const { return {_destinations.data(), _num_destinations}; }
+
+    std::array<Destination, kMaxDestinations> _destinations{};
+    size_t _num_destinations = 0;
+    Latest _latest{*this};
+};
+
+}
@@ -12,7 +12,15 @@ public:
 	virtual void sendProgram(uint8_t channel, uint8_t program) = 0;
 	virtual void sendControl(uint8_t channel, uint8_t control, uint8_t value) = 0;
 	virtual void sendSysEx(std::span<const uint8_t> sysex) = 0;
+	// One complete, already encoded message (status byte first)
+	virtual void sendMessage(std::span<const uint8_t> message) = 0;
 	virtual void setCallback(Callback callback) = 0;
+	// Bytes accepted by send*() that the transport hasn't handed off yet.
+	// Streaming senders wait for this to drain before queueing more.
+	virtual size_t pending() const { return 0; }
+	// Messages refused because the transport's queue was full. A message is
+	// either queued whole or counted here, never truncated.
+	virtual size_t dropped() const { return 0; }
 };
 
 }
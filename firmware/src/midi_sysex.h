@@ -53,11 +53,17 @@ public:
 
     size_t write(std::span<const uint8_t> input) {
         size_t written = 0;
-        for (auto b : input) {
-            if (!write(b)) {
+        while (written < input.size()) {
+            // 7 input bytes are exactly 8 output bytes, so whole groups can
+            // skip the bit accumulator whenever the stream is byte aligned
+            if (_bits == 0 && input.size() - written >= 7 && _offset + 8 < _buffer.size()) {
+                writeBlock(&input[written]);
+                written += 7;
+            } else if (write(input[written])) {
+                ++written;
+            } else {
                 break;
             }
-            ++written;
         }
         return written;
     }
@@ -92,7 +98,8 @@ public:
 
 private:
     bool write(uint8_t input) {
-        if (_offset + kSysExSuffix.size() >= _buffer.size()) {
+        // Every byte spills into the next output byte, ahead of the suffix
+        if (_offset + 1 + kSysExSuffix.size() >= _buffer.size()) {
             return false;
         }
         
@@ -105,6 +112,25 @@ private:
     
         return true;
     }
+
+    // Two 28 bit halves keep the packing in 32 bit registers on the M0+
+    void writeBlock(const uint8_t* input) {
+        uint32_t hi = (uint32_t(input[0]) << 20) | (uint32_t(input[1]) << 12) |
+                      (uint32_t(input[2]) << 4) | (input[3] >> 4);
+        uint32_t lo = (uint32_t(input[3] & 0x0F) << 24) | (uint32_t(input[4]) << 16) |
+                      (uint32_t(input[5]) << 8) | input[6];
+        uint8_t* out = &_buffer[_offset];
+        out[0] = (hi >> 21) & 0x7F;
+        out[1] = (hi >> 14) & 0x7F;
+        out[2] = (hi >> 7) & 0x7F;
+        out[3] = hi & 0x7F;
+        out[4] = (lo >> 21) & 0x7F;
+        out[5] = (lo >> 14) & 0x7F;
+        out[6] = (lo >> 7) & 0x7F;
+        out[7] = lo & 0x7F;
+        _offset += 8;
+        _buffer[_offset] = 0;
+    }
     
     std::span<uint8_t> _buffer{};
     size_t _bits{};
@@ -145,11 +171,16 @@ public:
 
     size_t read(std::span<uint8_t> output) {
         size_t bytes_read = 0;
-        for (auto& b : output) {
-            if (!read(b)) {
+        while (bytes_read < output.size()) {
+            // Aligned groups of 8 input bytes unpack to 7 bytes at once
+            if (_bits == 0 && output.size() - bytes_read >= 7 && _offset + 8 <= _buffer.size()) {
+                readBlock(&output[bytes_read]);
+                bytes_read += 7;
+            } else if (read(output[bytes_read])) {
+                ++bytes_read;
+            } else {
                 break;
             }
-            ++bytes_read;
         }
         return bytes_read;
     }
@@ -189,6 +220,22 @@ private:
         return true;
     }
 
+    void readBlock(uint8_t* output) {
+        const uint8_t* in = &_buffer[_offset];
+        uint32_t hi = (uint32_t(in[0] & 0x7F) << 21) | (uint32_t(in[1] & 0x7F) << 14) |
+                      (uint32_t(in[2] & 0x7F) << 7) | (in[3] & 0x7F);
+        uint32_t lo = (uint32_t(in[4] & 0x7F) << 21) | (uint32_t(in[5] & 0x7F) << 14) |
+                      (uint32_t(in[6] & 0x7F) << 7) | (in[7] & 0x7F);
+        output[0] = hi >> 20;
+        output[1] = hi >> 12;
+        output[2] = hi >> 4;
+        output[3] = (hi << 4) | (lo >> 24);
+        output[4] = lo >> 16;
+        output[5] = lo >> 8;
+        output[6] = lo;
+        _offset += 8;
+    }
+
     std::span<const uint8_t> _buffer;
     size_t _bits{};
     size_t _offset{};
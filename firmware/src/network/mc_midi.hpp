@@ -2,6 +2,8 @@
 
 #include "udp6.hpp"
 #include <midi_sender.h>
+#include <midi_parser.h>
+#include <spsc_ring.h>
 #include <poll_timer.h>
 #include <cstdint>
 
@@ -61,6 +63,61 @@ public:
     }
 
     void run() {
+        receive();
+        flush();
+    }
+
+	void sendProgram(uint8_t channel, uint8_t program) override {
+        const uint8_t message[] = {uint8_t(0xC0 | (channel & 0x0F)), program};
+        sendMessage(message);
+    }
+
+	void sendControl(uint8_t channel, uint8_t control, uint8_t value) override {
+        const uint8_t message[] = {uint8_t(0xB0 | (channel & 0x0F)), control, value};
+        sendMessage(message);
+    }
+
+	void sendSysEx(std::span<const uint8_t> sysex) override {
+        sendMessage(sysex);
+    }
+
+    void sendMessage(std::span<const uint8_t> message) override {
+        const uint16_t size = uint16_t(message.size());
+        if (message.size() > _packet.message.size() || _tx.free() < sizeof(size) + size) {
+            ++_dropped;
+            printf("MC MIDI queue full, dropped %u bytes (%zu total drops)\n", size, _dropped);
+            return;
+        }
+        _tx.write({reinterpret_cast<const uint8_t*>(&size), sizeof(size)});
+        _tx.write(message);
+    }
+
+    void setCallback(Callback callback) override {
+        _callback = callback;
+    }
+
+    size_t pending() const override { return _tx.size(); }
+    size_t dropped() const override { return _dropped; }
+
+    // Sends every queued message, one datagram each
+    void flush() {
+        uint16_t size;
+        while (_tx.read({reinterpret_cast<uint8_t*>(&size), sizeof(size)}) == sizeof(size)) {
+            _tx.read({_packet.message.data(), size});
+            _packet.header = {.sequence = _sequence++};
+            _socket.beginPacket(_addr, kPort);
+            _socket.write(_packet.bytes(), _packet.total_size(size));
+            _socket.endPacket();
+        }
+    }
+
+    // Link down: whatever is queued would be stale by the time it's back
+    void discard() {
+        _tx.consume(_tx.size());
+    }
+
+private:
+    void receive() {
         auto available = _socket.parsePacket();
         if (available == 0) {
             return;
@@ -77,43 +134,20 @@ public:
         }
 
         if (_callback) {
-            _callback(_packet.span(bytes_read), _packet.message, *this);
-        }
-    }
-
-	void sendProgram(uint8_t channel, uint8_t program) override {
-        _packet.header = {.sequence = _sequence++};
-        _packet.message[0] = 0xC0 | (channel & 0x0F);
-        _packet.message[1] = program;
-        sendPacket(2);
-    }
-
-	void sendControl(uint8_t channel, uint8_t control, uint8_t value) override {
-        _packet.header = {.sequence = _sequence++};
-        _packet.message[0] = 0xB0 | (channel & 0x0F);
-        _packet.message[1] = control;
-        _packet.message[2] = value;
-        sendPacket(3);
-    }
-
-	void sendSysEx(std::span<const uint8_t> sysex) override {
-        _packet.header = {.sequence = _sequence++};
-        if (sysex.data() != _packet.message.data()) {
-            memcpy(_packet.message.data(), sysex.data(), sysex.size());
+            // Datagrams carry whole messages, so nothing is carried over
+            // from a previous (possibly lost) packet
+            _parser.reset();
+            _parser.parse(_packet.span(bytes_read), [this](std::span<const uint8_t> message) {
+                _callback(message, _buffer, *this);
+            });
         }
-        sendPacket(sysex.size());
-    }
-
-    void setCallback(Callback callback) override {
-        _callback = callback;
     }
 
-private:
-    void sendPacket(uint16_t data_size) {
-        _socket.beginPacket(_addr, kPort);
-        _socket.write(_packet.bytes(), _packet.total_size(data_size));
-        _socket.endPacket();
-    }
+    // Messages are queued with a 16 bit length prefix, so each one is sent
+    // as its own datagram from run() and never blocks the sender, whatever
+    // the USB side is doing
+    static constexpr size_t kTxSize = 2048;
+    static_assert(kTxSize >= 2 * (sizeof(uint16_t) + kMidiSysExMaxSize));
 
     EthernetUDP6 _socket;
     Callback _callback{};
@@ -123,6 +157,12 @@ private:
     IP6Address _addr = kBaseAddr;
     uint8_t _sequence = 0;
     mcmidi::Packet _packet;
+    // Replies are built apart from _packet, which still holds the rest of the
+    // datagram being parsed
+    std::array<uint8_t, kMidiSysExMaxSize> _buffer;
+    MidiParser _parser;
+    SpscRing<kTxSize> _tx;
+    size_t _dropped = 0;
 };
 
 }
\ No newline at end of file
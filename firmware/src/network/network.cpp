@@ -24,7 +24,7 @@ void Network::reinitMidi(uint8_t midi_port) {
     _midi.reinit(midi_port);
 }
 
-void Network::run() {
+void Network::checkLink() {
     if (!_config.available) {
         return;
     }
@@ -37,9 +37,13 @@ void Network::run() {
             _onLinkUp();
         }
     }
+}
 
+void Network::run() {
     if (_connected) {
         _midi.run();
+    } else {
+        _midi.discard();
     }
 }
 
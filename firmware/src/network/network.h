@@ -18,6 +18,8 @@ public:
     void init(uint8_t midi_port);
     void reinitMidi(uint8_t midi_port);
     void run();
+    // Reads the PHY link state over MDIO, too slow for every loop pass
+    void checkLink();
     MidiSender& midi() { return _midi; }
     const MidiSender& midi() const { return _midi; }
     void setOnLinkUp(std::function<void()> cb) { _onLinkUp = std::move(cb); }
@@ -41,6 +43,7 @@ private:
 	    void sendProgram(uint8_t channel, uint8_t program) override {}
 	    void sendControl(uint8_t channel, uint8_t control, uint8_t value) override {}
     	void sendSysEx(std::span<const uint8_t> sysex) override {}
+    	void sendMessage(std::span<const uint8_t> message) override {}
         void setCallback(Callback callback) override {}
     };
 public:
@@ -48,6 +51,7 @@ public:
     void init(uint8_t midi_port) {}
     void reinitMidi(uint8_t midi_port) {}
     void run() {}
+    void checkLink() {}
     MidiSender& midi() { return _midi; }
     const MidiSender& midi() const { return _midi; }
     void setOnLinkUp(std::function<void()>) {}
@@ -6,13 +6,53 @@ void Expression::init() {
     _minRaw = 0;
     _maxRaw = (1 << 12) - 1;
     expression_init(_config);
+    // Let the first decimation window fill so run() starts with a value
+    sleep_ms(kDecimation * 1000 / kExpressionSampleRate + 1);
 }
 
 void Expression::run() {
     bool connected = isConnected();
-    _currentRaw = expression_read(_config);
+    if (!connected) {
+        // Drop whatever was converted while unplugged
+        uint16_t samples[kDecimation];
+        while (expression_read(_config, samples, kDecimation) > 0) {}
+        _accumulator = 0;
+        _accumulated = 0;
+        _currentRaw = 0;
+        update(kDisconnected);
+        return;
+    }
+
+    // Boxcar decimation: every kDecimation samples average into one value,
+    // so values come out at a fixed cadence however late run() is called.
+    // After a stall only the latest value is reported.
+    uint16_t samples[kDecimation];
+    size_t count;
+    uint8_t value = _currentValue;
+    uint16_t fine = _fineValue;
+    while ((count = expression_read(_config, samples, kDecimation - _accumulated)) > 0) {
+        for (size_t i = 0; i < count; ++i) {
+            _accumulator += samples[i];
+        }
+        _accumulated += count;
+        if (_accumulated == kDecimation) {
+            _currentRaw = uint16_t((_accumulator + kDecimation / 2) / kDecimation);
+            _accumulator = 0;
+            _accumulated = 0;
+            value = calculateValue(value);
+            fine = calculateFineValue(fine);
+        }
+    }
+    update(value);
+    if (fine != _fineValue) {
+        _fineValue = fine;
+        if (_fineCallback) {
+            _fineCallback(_fineValue);
+        }
+    }
+}
 
-    uint8_t value = connected ? calculateValue() : kDisconnected;
+void Expression::update(uint8_t value) {
     if (value != _currentValue) {
         _currentValue = value;
         if (_callback) {
@@ -21,7 +61,7 @@ void Expression::run() {
     }
 }
 
-uint8_t Expression::calculateValue() {
+uint8_t Expression::calculateValue(uint8_t previous) {
     if (_currentRaw < _minRaw) {
         _filterCenter = kMinValue - _filterRadius;
         return static_cast<uint8_t>(kMinValue);
@@ -32,22 +72,36 @@ uint8_t Expression::calculateValue() {
         return static_cast<uint8_t>(kMaxValue);
     }
 
-    float floatValue = static_cast<float>(_currentRaw - _minRaw);
-    floatValue /= static_cast<float>((_maxRaw - _minRaw));
-    floatValue *= static_cast<float>((kMaxValue - kMinValue) + 1);
-    int16_t intValue = static_cast<int16_t>(floatValue);
+    // Same scaling as (raw - min) / (max - min) * 128, without the floats
+    const uint32_t range = _maxRaw - _minRaw;
+    int16_t intValue = static_cast<int16_t>((uint32_t(_currentRaw - _minRaw) * ((kMaxValue - kMinValue) + 1)) / range);
 
     if (intValue > (_filterCenter + _filterRadius)) {
         _filterCenter = intValue - _filterRadius;        
     } else if (intValue < (_filterCenter - _filterRadius)) {
         _filterCenter = intValue + _filterRadius;
     } else {
-        intValue = _currentValue;
+        intValue = previous;
     }
 
     return static_cast<uint8_t>(intValue);
 }
 
+uint16_t Expression::calculateFineValue(uint16_t previous) const {
+    if (_currentRaw <= _minRaw) {
+        return 0;
+    }
+
+    if (_currentRaw >= _maxRaw) {
+        return kFineMax;
+    }
+
+    const uint32_t range = _maxRaw - _minRaw;
+    const uint16_t fine = static_cast<uint16_t>((uint32_t(_currentRaw - _minRaw) * (kFineMax + 1)) / range);
+    const uint16_t delta = fine > previous ? fine - previous : previous - fine;
+    return delta > kFineDeadband ? fine : previous;
+}
+
 void Expression::incFilter() { 
     _filterRadius += (_filterRadius < kMaxFilter) ? 1 : 0;
     printf("Exp filter: %d\n", _filterRadius);
@@ -58,4 +112,4 @@ void Expression::decFilter() {
     printf("Exp filter: %d\n", _filterRadius);
 }
 
-} // namespace tocata
\ No newline at end of file
+} // namespace tocata
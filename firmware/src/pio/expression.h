@@ -10,8 +10,12 @@
 namespace tocata {
 
 class Expression {
+    // 32 samples at 8 kHz: a new value every 4 ms
+    static constexpr size_t kDecimation = 32;
+
 public:
     using Callback = std::function<void(uint16_t)>;
+    using FineCallback = std::function<void(uint16_t)>;
 
     Expression(const HWConfigExpression& config) : _config(config) {}
     void init();
@@ -19,10 +23,16 @@ public:
     void incFilter();
     void decFilter();
     uint8_t getValue() { return _currentValue; };
+    // 14 bit position (0..kFineMax) for CC MSB/LSB pairs
+    uint16_t getFineValue() const { return _fineValue; }
     bool isConnected() { return expression_is_connected(_config); }
 
     static constexpr uint8_t kDisconnected = 0xFF;
+    static constexpr uint16_t kFineMax = (1 << 14) - 1;
+    // How often run() has a new value to offer
+    static constexpr uint32_t kPeriodUs = kDecimation * 1000000 / kExpressionSampleRate;
     void setCallback(Callback callback) { _callback = callback; }
+    void setFineCallback(FineCallback callback) { _fineCallback = callback; }
     void resetMax() { _maxRaw = _currentRaw; }
     void resetMin() { _minRaw = _currentRaw; }
     uint16_t getMinRaw() const { return _minRaw; }
@@ -34,17 +44,26 @@ private:
     static constexpr int16_t kMaxValue = 127;
     static constexpr int16_t kMaxFilter = 3;
     static constexpr int16_t kDefaultFilter = 1;
+    // A 12 bit ADC only has 2 real bits below the 7 bit value, so the fine
+    // value moves in steps of 4; twice that keeps noise from reaching MIDI
+    static constexpr uint16_t kFineDeadband = 8;
 
-    uint8_t calculateValue();
+    void update(uint8_t value);
+    uint8_t calculateValue(uint8_t previous);
+    uint16_t calculateFineValue(uint16_t previous) const;
 
     const HWConfigExpression& _config;
-    uint16_t _currentRaw;
+    uint16_t _currentRaw = 0;
+    uint32_t _accumulator = 0;
+    size_t _accumulated = 0;
     uint8_t _currentValue = kDisconnected;
     int16_t  _filterRadius = kDefaultFilter;
     int16_t  _filterCenter = kMinValue - _filterRadius;
     uint16_t _maxRaw;
     uint16_t _minRaw;
+    uint16_t _fineValue = 0;
     Callback _callback = nullptr;
+    FineCallback _fineCallback = nullptr;
 };
 
 } // namespace tocata
\ No newline at end of file
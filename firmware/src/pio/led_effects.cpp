@@ -0,0 +1,156 @@
+#include "led_effects.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace tocata {
+
+LedEffects::LedEffects(Leds& leds) : _leds(leds)
+{
+    for (int level = 0; level <= kMax; ++level) {
+        _gamma[level] = static_cast<uint8_t>(kMax * std::pow(static_cast<float>(level) / kMax, 2.2f) + 0.5f);
+    }
+}
+
+void LedEffects::start(uint8_t led, const Effect& effect)
+{
+    _effects[led] = effect;
+    _effects[led].start = millis();
+    // The first frame right away; the next tick() refreshes it
+    const RGB rgb = render(_effects[led], _effects[led].start);
+    _rendered[led] = rgb;
+    _leds.setColor(led, rgb.r, rgb.g, rgb.b);
+    _dirty = true;
+}
+
+void LedEffects::fade(uint8_t led, RGB from, RGB to, uint16_t duration_ms)
+{
+    start(led, {.type = kFade, .from = from, .to = to, .period = std::max<uint32_t>(duration_ms, 1)});
+}
+
+void LedEffects::pulse(uint8_t led, RGB color, uint16_t period_ms)
+{
+    start(led, {.type = kPulse, .to = color, .period = std::max<uint32_t>(period_ms, 2)});
+}
+
+void LedEffects::blink(uint8_t led, RGB on, RGB off, uint32_t period_ms, uint32_t on_ms)
+{
+    start(led, {.type = kBlink, .from = off, .to = on, .period = std::max<uint32_t>(period_ms, 1), .on = on_ms});
+}
+
+void LedEffects::stop(uint8_t led)
+{
+    _effects[led].type = kNone;
+}
+
+void LedEffects::stopAll()
+{
+    for (auto& effect : _effects) {
+        effect.type = kNone;
+    }
+}
+
+void LedEffects::meter(uint8_t note, int cents)
+{
+    stopAll();
+
+    // Full-scale tuning offset.
+    static constexpr int kMinCents = -64;
+    static constexpr int kMaxCents = 63;
+
+    RGB col[4] = {};  // per-column color; up to 4 columns
+    const uint8_t columns = std::min<uint8_t>(_leds.kNumLeds / 2, std::size(col));  // 4 (long) or 3 (short)
+
+    // Wider dead zone: the middle column(s) show solid green here.
+    const bool in_tune = (cents >= -4 && cents <= 3);
+
+    if (note < 24) {
+        // No valid note: leave everything off.
+    } else if (in_tune) {
+        if (columns >= 4) {
+            col[1] = col[2] = {0, kMax, 0};
+        } else {
+            col[1] = {0, kMax, 0};
+        }
+    } else {
+        // Continuous moving bar: map cents to a position across the column
+        // index range and split intensity between the two nearest columns
+        // with a triangular falloff. Integer math, scaled by D = range size.
+        const int c = std::min(std::max(cents, kMinCents), kMaxCents);
+        const int D = kMaxCents - kMinCents;  // 127
+        const int N = columns - 1;
+        for (uint8_t i = 0; i < columns; ++i) {
+            const int diff = (c - kMinCents) * N - static_cast<int>(i) * D;
+            const int adiff = diff < 0 ? -diff : diff;
+            const int level = kMax - (kMax * adiff + D / 2) / D;
+            if (level > 0) {
+                col[i] = {_gamma[level], 0, 0};
+            }
+        }
+    }
+
+    for (uint8_t i = 0; i < _leds.kNumLeds; ++i) {
+        const RGB& c = col[i % columns];
+        _leds.setColor(i, c.r, c.g, c.b);
+    }
+    _dirty = true;
+}
+
+LedEffects::RGB LedEffects::render(const Effect& effect, uint32_t now_ms) const
+{
+    const uint32_t elapsed = now_ms - effect.start;
+    switch (effect.type) {
+        case kFade:
+            if (elapsed >= effect.period) {
+                return effect.to;
+            }
+            return {
+                lerp(effect.from.r, effect.to.r, elapsed, effect.period),
+                lerp(effect.from.g, effect.to.g, elapsed, effect.period),
+                lerp(effect.from.b, effect.to.b, elapsed, effect.period),
+            };
+        case kPulse: {
+            // Triangle wave, gamma corrected so it doesn't linger at the top
+            const uint32_t half = effect.period / 2;
+            const uint32_t phase = elapsed % effect.period;
+            const uint32_t ramp = std::min(phase < half ? phase : effect.period - phase, half);
+            const uint8_t level = _gamma[kMax * ramp / half];
+            return {
+                uint8_t(effect.to.r * level / kMax),
+                uint8_t(effect.to.g * level / kMax),
+                uint8_t(effect.to.b * level / kMax),
+            };
+        }
+        case kBlink:
+            return (elapsed % effect.period) < effect.on ? effect.to : effect.from;
+        default:
+            return {};
+    }
+}
+
+void LedEffects::tick(uint32_t now_ms)
+{
+    for (uint8_t led = 0; led < _leds.kNumLeds; ++led) {
+        const Effect& effect = _effects[led];
+        if (effect.type == kNone) {
+            continue;
+        }
+        const RGB rgb = render(effect, now_ms);
+        if (rgb != _rendered[led]) {
+            _rendered[led] = rgb;
+            _leds.setColor(led, rgb.r, rgb.g, rgb.b);
+            _dirty = true;
+        }
+        if (effect.type == kFade && now_ms - effect.start >= effect.period) {
+            stop(led);
+        }
+    }
+
+    if (_dirty) {
+        _dirty = false;
+        _leds.refresh();
+    }
+}
+
+} // namespace tocata
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "leds.h"
+
+#include <cstdint>
+
+namespace tocata {
+
+// Timed LED effects on top of Leds: fades, pulses, blinks and the tuner
+// meter. Each effect is a function of the time since it started, so effects
+// never drift, and tick() renders every active one into the Leds frame and
+// asks for a single refresh, at most one frame per tick however often the
+// effects are changed. Static colors still go straight to Leds; starting an
+// effect takes the LED over until stop().
+class LedEffects
+{
+public:
+    using RGB = Leds::RGB;
+
+    static constexpr uint32_t kTickUs = 20000;  // 50 frames per second
+    static constexpr int kMax = 128;            // max LED intensity
+
+    LedEffects(Leds& leds);
+
+    // From `from` to `to` in duration_ms, then holds `to`
+    void fade(uint8_t led, RGB from, RGB to, uint16_t duration_ms);
+    // Breathes between off and `color` once per period, perceptually even
+    void pulse(uint8_t led, RGB color, uint16_t period_ms);
+    // `on` for the first on_ms of every period, `off` for the rest. The
+    // first period starts now, so restarting it re-phases the blink.
+    void blink(uint8_t led, RGB on, RGB off, uint32_t period_ms, uint32_t on_ms);
+    // Leaves the LED showing whatever the effect rendered last
+    void stop(uint8_t led);
+    void stopAll();
+
+    // Tuner meter across every LED: the columns of the pedal form a bar
+    // that follows `cents`, solid green when in tune and dark without a note
+    void meter(uint8_t note, int cents);
+
+    void tick(uint32_t now_ms);
+
+private:
+    enum Type : uint8_t
+    {
+        kNone,
+        kFade,
+        kPulse,
+        kBlink,
+    };
+
+    struct Effect
+    {
+        Type type = kNone;
+        RGB from{};
+        RGB to{};
+        uint32_t start = 0;
+        uint32_t period = 0;
+        uint32_t on = 0;
+    };
+
+    static uint8_t lerp(uint8_t from, uint8_t to, uint32_t t, uint32_t d)
+    {
+        return uint8_t(from + (int32_t(to) - from) * int32_t(t) / int32_t(d));
+    }
+    RGB render(const Effect& effect, uint32_t now_ms) const;
+    void start(uint8_t led, const Effect& effect);
+
+    Leds& _leds;
+    Effect _effects[Leds::kMaxLeds];
+    RGB _rendered[Leds::kMaxLeds] = {};  // last color each effect produced
+    bool _dirty = false;
+    // Gamma-correct (gamma = 2.2) lookup table: _gamma[level] is the duty
+    // cycle that looks as bright to the eye as a linear ramp at `level`
+    uint8_t _gamma[kMax + 1] = {};
+};
+
+} // namespace tocata
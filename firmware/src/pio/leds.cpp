@@ -12,11 +12,8 @@ void Leds::init()
 
 void Leds::setColor(uint8_t led, Color color, bool active)
 {
-    const RGB& rgb = kColors[color];
-    setColor(led, 
-        brightness(rgb.r, active),
-        brightness(rgb.g, active),
-        brightness(rgb.b, active));
+    const RGB c = rgb(color, active);
+    setColor(led, c.r, c.g, c.b);
 }
 
 void Leds::setColor(uint8_t led, uint8_t r, uint8_t g, uint8_t b)
@@ -25,23 +22,24 @@ void Leds::setColor(uint8_t led, uint8_t r, uint8_t g, uint8_t b)
     _state[led] = (g << 24) | (r << 16) | (b << 8);
 }
 
-void Leds::refresh(bool wait)
+void Leds::flush()
 {
-    if (wait) {
-        _timer.wait();
+    while (leds_busy()) {
     }
     _refresh_pending = true;
+    run();
 }
 
 void Leds::run()
 {
-    if (!_refresh_pending || !_timer.expired()) {
+    if (!_refresh_pending || leds_busy()) {
         return;
     }
 
+    // A setColor() while the frame is going out can at worst show one LED
+    // early; it leaves a refresh pending that sends the final frame next
     _refresh_pending = false;
     leds_refresh(_config, _state, kNumLeds);
-    _timer.start(1000);
 }
 
 } // namespace tocata
@@ -2,7 +2,6 @@
 
 #include "hal.h"
 #include "config.h"
-#include "poll_timer.h"
 
 #include <cstdint>
 #include <bitset>
@@ -15,22 +14,36 @@ public:
     static constexpr uint8_t kMaxLeds = 8;
     const uint8_t kNumLeds = is_pedal_long() ? 8 : 6;
 
+    struct RGB
+    {
+        uint8_t r;
+        uint8_t g;
+        uint8_t b;
+
+        bool operator==(const RGB&) const = default;
+    };
+
     Leds(const HWConfigLeds& config) : _config(config) {}
 
     void init();
     void run();
     void setColor(uint8_t led, Color color, bool active);
     void setColor(uint8_t led, uint8_t r, uint8_t g, uint8_t b);
-    void refresh(bool wait = false);
+    // Never blocks: the frame goes out from run() as soon as the LEDs are free
+    void refresh() { _refresh_pending = true; }
+    // Sends the frame now, waiting out the previous one's latch (well under
+    // a millisecond). Only for paths that block anyway, like a factory reset.
+    void flush();
+    bool pending() const { return _refresh_pending; }
 
-private:
-    struct RGB
+    // A palette color as setColor(led, color, active) shows it
+    static RGB rgb(Color color, bool active)
     {
-        uint8_t r;
-        uint8_t g;
-        uint8_t b;
-    };
+        const RGB& rgb = kColors[color];
+        return {brightness(rgb.r, active), brightness(rgb.g, active), brightness(rgb.b, active)};
+    }
 
+private:
     static constexpr uint8_t kFull = 128;
     static constexpr uint8_t kHalf = 64;
     static constexpr uint8_t kOff = 0;
@@ -50,10 +63,11 @@ private:
         return active ? orig : 2 * (orig / kHalf);
     }
 
+    // The frame as sent: brightness is applied by setColor(), so a refresh
+    // is only the DMA transfer
     uint32_t _state[kMaxLeds] = {};
     const HWConfigLeds& _config;
     bool _refresh_pending = false;
-    PollTimer _timer{};
 };
 
 } // namespace tocata
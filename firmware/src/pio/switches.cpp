@@ -11,26 +11,29 @@ void Switches::init()
 
 void Switches::run()
 {
-    uint32_t now = millis();
-    Mask raw_sample = switches_value(_config);
-
-
-    Mask changed_this_tick;
-
-    for (size_t i = 0; i < kNumSwitches; ++i) {
-        // Check if this specific button is currently in a lockout period
-        if (now - _last_change_time[i] < kDebounceMs) {
-            continue; 
-        }
-
-        // Detect immediate change
-        if (raw_sample[i] != _stable_states[i]) {
-            _stable_states[i] = raw_sample[i];
-            _last_change_time[i] = now; // Start the lockout timer
-            changed_this_tick.set(i);
+    // Every event is handled on its own, so a press and release that both
+    // landed since the last loop still arrive as two callbacks
+    const Mask used = Mask{}.set() >> (kMaxSwitches - kNumSwitches);
+    SwitchEvent event;
+    bool changed = false;
+    while (switches_pop_event(_config, event)) {
+        const Mask state = Mask(event.value) & used;
+        const Mask changed_now = state ^ _stable_states;
+        if (changed_now.any()) {
+            _stable_states = state;
+            _event_time = event.time_us;
+            // Edge time on the millis() clock the detection window runs on
+            update(changed_now, millis() - (micros() - event.time_us) / 1000);
+            changed = true;
         }
     }
+    if (!changed) {
+        update({}, millis());
+    }
+}
 
+void Switches::update(Mask changed_this_tick, uint32_t now)
+{
     if (!_detection_delay) {
         // Immediate path: fire on any change, no added latency.
         if (changed_this_tick.any() && _callback) {
@@ -29,24 +29,24 @@ public:
     // near-simultaneous presses arrive together. Disabled = immediate, zero latency.
     void setDetectionDelay(bool enable) { _detection_delay = enable; _pending_changed.reset(); }
     Mask rawMask() const;
+    // micros() time of the edge behind the change being reported, for
+    // callbacks that need more than loop precision
+    uint32_t eventTime() const { return _event_time; }
+    // Changes are being held for the detection delay
+    bool pending() const { return _pending_changed.any(); }
 
 private:
-    static constexpr uint32_t kDebounceMs = 200;
     static constexpr uint32_t kDetectionDelayMs = 75;
 
-    // int _sm;
-    // Mask _state{};
-    // Mask _debouncing{};
-    // Mask _debouncing_state{};
-    // uint32_t _debouncing_start;
-
+    void update(Mask changed, uint32_t now);
 
+    // Debouncing happens in the HAL (a PIO program on the Pico), which hands
+    // out timestamped, already stable edges
     const HWConfigSwitches& _config;
     SwitchesChanged _callback{};
     Mask _stable_states;
-    std::array<uint32_t, kMaxSwitches> _last_change_time; // Fixed-size array for lockout timestamps
-    uint32_t _lockout_duration;
     bool _detection_delay = false;
+    uint32_t _event_time = 0;
     Mask _pending_changed{};      // changes accumulated during the current detection window
     uint32_t _window_start = 0;   // millis() of the first change in the current window
 };
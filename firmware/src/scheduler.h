@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <span>
+
+namespace tocata {
+
+// Periodic tasks for the main loop. Instead of every subsystem polling its
+// own PollTimer on each pass, the loop runs what's due and then sleeps until
+// deadline(): interrupts (USB, switches, Ethernet, the MIDI clock alarm) wake
+// it early, so between events and deadlines no time is spent polling.
+//
+// With a handful of tasks a linear scan beats any wheel or heap; times are
+// micros() and every comparison is wrap safe.
+class Scheduler {
+public:
+    static constexpr size_t kMaxTasks = 8;
+    using Task = std::function<void()>;
+
+    // Runs `task` every `period` microseconds, the first time on the next run()
+    bool every(uint32_t period, Task task, uint32_t now) {
+        if (_num_tasks == kMaxTasks) {
+            return false;
+        }
+        _tasks[_num_tasks++] = {.task = std::move(task), .period = period, .next = now};
+        return true;
+    }
+
+    // Runs the tasks that are due. Each is re-armed from its previous
+    // deadline, so cadences don't drift, unless it fell a whole period
+    // behind: then it restarts from now rather than running in a burst.
+    void run(uint32_t now) {
+        _wake = false;
+        for (auto& entry : tasks()) {
+            if (!due(entry.next, now)) {
+                continue;
+            }
+            entry.task();
+            entry.next += entry.period;
+            if (due(entry.next, now)) {
+                entry.next = now + entry.period;
+            }
+        }
+    }
+
+    // One-off earlier deadline, for work that's pending but rate limited.
+    // Only holds until the next run().
+    void wakeBy(uint32_t deadline) {
+        if (!_wake || before(deadline, _wake_at)) {
+            _wake_at = deadline;
+            _wake = true;
+        }
+    }
+
+    // When the loop has to run again at the latest
+    uint32_t deadline(uint32_t now) const {
+        uint32_t deadline = now + kMaxSleep;
+        for (const auto& entry : tasks()) {
+            if (before(entry.next, deadline)) {
+                deadline = entry.next;
+            }
+        }
+        if (_wake && before(_wake_at, deadline)) {
+            deadline = _wake_at;
+        }
+        return deadline;
+    }
+
+private:
+    // Bounds the sleep when there are no tasks, and keeps the wrap safe
+    // comparisons valid
+    static constexpr uint32_t kMaxSleep = 1000000;
+
+    struct Entry {
+        Task task;
+        uint32_t period;
+        uint32_t next;
+    };
+
+    static bool before(uint32_t a, uint32_t b) { return static_cast<int32_t>(a - b) < 0; }
+    static bool due(uint32_t deadline, uint32_t now) { return !before(now, deadline); }
+
+    std::span<Entry> tasks() { return {_tasks.data(), _num_tasks}; }
+    std::span<const Entry> tasks() const { return {_tasks.data(), _num_tasks}; }
+
+    std::array<Entry, kMaxTasks> _tasks{};
+    size_t _num_tasks = 0;
+    uint32_t _wake_at = 0;
+    bool _wake = false;
+};
+
+}
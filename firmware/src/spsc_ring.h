@@ -0,0 +1,89 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+namespace tocata {
+
+// Fixed capacity, lock-free byte ring for exactly one producer and one
+// consumer, which may run on different threads (or a core and an IRQ). Each
+// side only ever stores its own index, published with release semantics, so
+// there are no locks and no per-byte bookkeeping: both directions copy in at
+// most two contiguous chunks.
+template <size_t kCapacity>
+class SpscRing {
+    static_assert(kCapacity > 0 && (kCapacity & (kCapacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+    static constexpr size_t capacity() { return kCapacity; }
+
+    // Producer side. All or nothing, so a MIDI message is never split
+    // between a full ring and a later write.
+    bool write(std::span<const uint8_t> data) {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        const size_t tail = _tail.load(std::memory_order_acquire);
+        if (data.size() > kCapacity - (head - tail)) {
+            return false;
+        }
+
+        const size_t offset = head & kMask;
+        const size_t first = std::min(data.size(), kCapacity - offset);
+        std::copy_n(data.begin(), first, _buffer.begin() + offset);
+        std::copy(data.begin() + first, data.end(), _buffer.begin());
+        _head.store(head + data.size(), std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Copies out as much as is available, up to output.size().
+    size_t read(std::span<uint8_t> output) {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        const size_t head = _head.load(std::memory_order_acquire);
+        const size_t count = std::min(output.size(), head - tail);
+
+        const size_t offset = tail & kMask;
+        const size_t first = std::min(count, kCapacity - offset);
+        std::copy_n(_buffer.begin() + offset, first, output.begin());
+        std::copy_n(_buffer.begin(), count - first, output.begin() + first);
+        _tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer side, for zero copy draining: the longest contiguous run of
+    // queued bytes, released with consume() once the caller is done with it
+    std::span<const uint8_t> peek() const {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        const size_t head = _head.load(std::memory_order_acquire);
+        const size_t offset = tail & kMask;
+        return {_buffer.data() + offset, std::min(head - tail, kCapacity - offset)};
+    }
+
+    void consume(size_t count) {
+        _tail.store(_tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    // A snapshot that can only be stale in the safe direction for the
+    // caller: the consumer never sees more data, nor the producer more room,
+    // than there really is
+    size_t size() const {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+    size_t free() const { return kCapacity - size(); }
+    bool empty() const { return size() == 0; }
+
+private:
+    static constexpr size_t kMask = kCapacity - 1;
+
+    // Indices run freely and wrap with size_t; only their difference and
+    // their low bits are used. Separate cache lines keep the two threads of
+    // the host build from false sharing.
+    alignas(64) std::atomic<size_t> _head{0};
+    alignas(64) std::atomic<size_t> _tail{0};
+    std::array<uint8_t, kCapacity> _buffer;
+};
+
+}
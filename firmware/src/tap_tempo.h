@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+namespace tocata {
+
+// Tempo from footswitch taps: the average of the last kMaxIntervals tap
+// intervals, in microseconds per quarter note. A pause longer than the
+// slowest tempo starts a new measurement, so one stray tap never drags an
+// established tempo.
+class TapTempo {
+public:
+    static constexpr size_t kMaxIntervals = 4;
+    static constexpr uint32_t kMinBpm = 30;
+    static constexpr uint32_t kMaxBpm = 300;
+    static constexpr uint32_t kMaxInterval = 60000000 / kMinBpm;
+    static constexpr uint32_t kMinInterval = 60000000 / kMaxBpm;
+
+    // Returns true when the tap produced a (new) tempo
+    bool tap(uint32_t now) {
+        const uint32_t interval = now - _last_tap;
+        const bool first = !_tapped;
+        _last_tap = now;
+        _tapped = true;
+        if (first || interval > kMaxInterval) {
+            _num_intervals = 0;
+            _next = 0;
+            return false;
+        }
+        if (interval < kMinInterval) {
+            // A double trigger rather than a tempo: keep the first tap
+            _last_tap = now - interval;
+            return false;
+        }
+
+        _intervals[_next] = interval;
+        _next = (_next + 1) % kMaxIntervals;
+        if (_num_intervals < kMaxIntervals) {
+            ++_num_intervals;
+        }
+        return true;
+    }
+
+    void reset() {
+        _tapped = false;
+        _num_intervals = 0;
+        _next = 0;
+    }
+
+    bool available() const { return _num_intervals > 0; }
+
+    // Microseconds per quarter note; 0 until two taps have been seen
+    uint32_t interval() const {
+        if (_num_intervals == 0) {
+            return 0;
+        }
+        uint32_t sum = 0;
+        for (size_t i = 0; i < _num_intervals; ++i) {
+            sum += _intervals[i];
+        }
+        return sum / _num_intervals;
+    }
+
+    uint32_t bpm() const {
+        const uint32_t quarter = interval();
+        return quarter ? (60000000 + quarter / 2) / quarter : 0;
+    }
+
+private:
+    std::array<uint32_t, kMaxIntervals> _intervals{};
+    size_t _num_intervals = 0;
+    size_t _next = 0;
+    uint32_t _last_tap = 0;
+    bool _tapped = false;
+};
+
+}
@@ -10,6 +10,12 @@ void ConfigProtocol::processRequest()
   const Message& msg = reinterpret_cast<const Message&>(_in_out_buf);
   // printf("process request %u status %u length %u\n", msg.command, msg.status, msg.length);
 
+  // Any other request ends an import in progress
+  if (msg.command != kImport)
+  {
+    _import_state = kImportIdle;
+  }
+
   switch (msg.command)
   {
     case kRestart:
@@ -51,6 +57,12 @@ void ConfigProtocol::processRequest()
     case kDeleteSetlist:
       deleteSetlist();
       break;
+    case kExport:
+      exportAll();
+      break;
+    case kImport:
+      importRecord();
+      break;
     case kMemRead:
       memRead();
       break;
@@ -60,6 +72,9 @@ void ConfigProtocol::processRequest()
     case kFlashErase:
       flashErase();
       break;
+    case kGetDiagnostics:
+      getDiagnostics();
+      break;
     default:
       memmove(_in_out_buf.data() + sizeof(msg), _in_out_buf.data(), _in_out_buf.size() - sizeof(msg));
       sendResponse(_in_out_buf.size() - sizeof(msg), kInvalidCommand);
@@ -93,8 +108,7 @@ void ConfigProtocol::setConfig()
   Message& msg = reinterpret_cast<Message&>(_in_out_buf);
   const SetConfigReq& req = reinterpret_cast<const SetConfigReq&>(msg.payload);
 
-  req.config.save();
-  sendStatus(kOk);
+  sendStatus(req.config.save() ? kOk : kStorageFull);
   _delegate.configChanged();
 }
 
@@ -174,8 +188,7 @@ void ConfigProtocol::setProgram()
     return;
   }
 
-  req.program.save(req.id);
-  sendStatus(kOk);
+  sendStatus(req.program.save(req.id) ? kOk : kStorageFull);
   _delegate.programChanged(req.id);
 }
 
@@ -273,8 +286,7 @@ void ConfigProtocol::setSetlist()
     return;
   }
 
-  req.setlist.save(req.id);
-  sendStatus(kOk);
+  sendStatus(req.setlist.save(req.id) ? kOk : kStorageFull);
 }
 
 void ConfigProtocol::deleteSetlist()
@@ -297,6 +309,217 @@ void ConfigProtocol::deleteSetlist()
   sendStatus(kOk);
 }
 
+void ConfigProtocol::exportAll()
+{
+  _export_cursor = 0;
+  exportRecord();
+}
+
+void ConfigProtocol::exportRecord()
+{
+  Message& msg = reinterpret_cast<Message&>(_in_out_buf);
+  msg.command = kExport;
+  Record& record = reinterpret_cast<Record&>(msg.payload);
+
+  // Empty program and setlist slots are skipped rather than sent
+  while (_export_cursor < kExportEnd)
+  {
+    const uint8_t cursor = _export_cursor++;
+    if (cursor < kExportPrograms)
+    {
+      record.type = kRecordConfig;
+      ConfigReqRes& res = reinterpret_cast<ConfigReqRes&>(record.data);
+      res.config.load();
+      sendResponse(sizeof(record) + sizeof(res));
+      return;
+    }
+    else if (cursor < kExportSetlists)
+    {
+      IdAndProgram& res = reinterpret_cast<IdAndProgram&>(record.data);
+      res.id = cursor - kExportPrograms;
+      if (res.program.load(res.id))
+      {
+        record.type = kRecordProgram;
+        sendResponse(sizeof(record) + sizeof(res));
+        return;
+      }
+    }
+    else
+    {
+      IdAndSetlist& res = reinterpret_cast<IdAndSetlist&>(record.data);
+      res.id = cursor - kExportSetlists;
+      if (res.setlist.load(res.id))
+      {
+        record.type = kRecordSetlist;
+        sendResponse(sizeof(record) + sizeof(res));
+        return;
+      }
+    }
+  }
+
+  _export_cursor = kExportDone;
+  record.type = kRecordEnd;
+  sendResponse(sizeof(record));
+}
+
+void ConfigProtocol::importRecord()
+{
+  Message& msg = reinterpret_cast<Message&>(_in_out_buf);
+  const Record& record = reinterpret_cast<const Record&>(msg.payload);
+  if (msg.length < sizeof(record))
+  {
+    importReject(kInvalidLength);
+    return;
+  }
+
+  if (record.type == kRecordBegin)
+  {
+    _imported_programs.reset();
+    _imported_setlists.reset();
+    _import_applied = 0;
+    _import_state = kImportActive;
+    importAck();
+    return;
+  }
+
+  if (_import_state == kImportRejected)
+  {
+    return;
+  }
+
+  if (_import_state != kImportActive)
+  {
+    importReject(kInvalidCommand);
+    return;
+  }
+
+  switch (record.type)
+  {
+    case kRecordConfig:
+    {
+      const ConfigReqRes& req = reinterpret_cast<const ConfigReqRes&>(record.data);
+      if (msg.length < sizeof(record) + sizeof(req))
+      {
+        importReject(kInvalidLength);
+        return;
+      }
+      if (!req.config.save())
+      {
+        importReject(kStorageFull);
+        return;
+      }
+      _delegate.configChanged();
+      break;
+    }
+    case kRecordProgram:
+    {
+      const IdAndProgram& req = reinterpret_cast<const IdAndProgram&>(record.data);
+      if (msg.length < sizeof(record) + sizeof(req))
+      {
+        importReject(kInvalidLength);
+        return;
+      }
+      if (req.id >= Program::kMaxPrograms)
+      {
+        importReject(kInvalidProgramId);
+        return;
+      }
+      if (!req.program.save(req.id))
+      {
+        importReject(kStorageFull);
+        return;
+      }
+      _imported_programs.set(req.id);
+      _delegate.programChanged(req.id);
+      break;
+    }
+    case kRecordSetlist:
+    {
+      const IdAndSetlist& req = reinterpret_cast<const IdAndSetlist&>(record.data);
+      if (msg.length < sizeof(record) + sizeof(req))
+      {
+        importReject(kInvalidLength);
+        return;
+      }
+      if (req.id >= Setlist::kMaxSetlists)
+      {
+        importReject(kInvalidSetlistId);
+        return;
+      }
+      if (!req.setlist.save(req.id))
+      {
+        importReject(kStorageFull);
+        return;
+      }
+      _imported_setlists.set(req.id);
+      break;
+    }
+    case kRecordEnd:
+      // An import is a full sync: whatever it didn't carry is gone. Deleting
+      // it all could take a while, so run() does it and then acknowledges.
+      ++_import_applied;
+      _remove_cursor = 0;
+      _import_state = kImportRemoving;
+      return;
+    default:
+      importReject(kInvalidCommand);
+      return;
+  }
+
+  ++_import_applied;
+  if (_import_applied % kImportAckEvery == 0)
+  {
+    importAck();
+  }
+}
+
+void ConfigProtocol::importAck()
+{
+  Message& msg = reinterpret_cast<Message&>(_in_out_buf);
+  ImportAck& res = reinterpret_cast<ImportAck&>(msg.payload);
+  res.applied = _import_applied;
+  res.window = kImportWindow;
+  sendResponse(sizeof(res));
+}
+
+void ConfigProtocol::importReject(Status status)
+{
+  _import_state = kImportRejected;
+  sendStatus(status);
+}
+
+void ConfigProtocol::importRemove()
+{
+  // Items the import carried are skipped, up to the next one to delete
+  while (_remove_cursor < kRemoveDone)
+  {
+    const uint8_t cursor = _remove_cursor++;
+    if (cursor < kRemoveSetlists)
+    {
+      if (!_imported_programs[cursor])
+      {
+        Program::remove(cursor);
+        _delegate.programChanged(cursor);
+        return;
+      }
+    }
+    else if (!_imported_setlists[cursor - kRemoveSetlists])
+    {
+      Setlist::remove(cursor - kRemoveSetlists);
+      return;
+    }
+  }
+
+  if (_sender->pending() > 0)
+  {
+    return;
+  }
+  _import_state = kImportIdle;
+  Message& msg = reinterpret_cast<Message&>(_in_out_buf);
+  msg.command = kImport;
+  importAck();
+}
+
 void ConfigProtocol::memRead()
 {
   Message& msg = reinterpret_cast<Message&>(_in_out_buf);
@@ -395,6 +618,16 @@ void ConfigProtocol::flashErase()
   sendStatus(kOk);
 }
 
+void ConfigProtocol::getDiagnostics()
+{
+  Message& msg = reinterpret_cast<Message&>(_in_out_buf);
+
+  GetDiagnosticsRes& res = reinterpret_cast<GetDiagnosticsRes&>(msg.payload);
+  res = {};
+  _delegate.getDiagnostics(res);
+  sendResponse(sizeof(res));
+}
+
 void ConfigProtocol::sendResponse(uint16_t length, Status status)
 {
   Message& msg = *reinterpret_cast<Message*>(_in_out_buf.data());
@@ -406,12 +639,16 @@ void ConfigProtocol::sendResponse(uint16_t length, Status status)
 }
 
 
-std::span<const uint8_t> ConfigProtocol::processSysEx(std::span<const uint8_t> sysex, std::span<uint8_t> buffer, uint8_t channel) {
+std::span<const uint8_t> ConfigProtocol::processSysEx(std::span<const uint8_t> sysex, std::span<uint8_t> buffer, uint8_t channel, MidiSender& sender) {
   MidiSysExParser parser;
   if (!parser.init(sysex, channel)) {
     return {};
   }
 
+  // Any request, including a new export, cancels an export in progress
+  _export_cursor = kExportDone;
+  _sender = &sender;
+  _channel = channel;
   _in_length = uint32_t(parser.read(_in_out_buf));
   processRequest();
   if (_out_pending == 0) {
@@ -425,4 +662,23 @@ std::span<const uint8_t> ConfigProtocol::processSysEx(std::span<const uint8_t> s
   return writer.buffer();
 }
 
+void ConfigProtocol::run()
+{
+  if (_import_state == kImportRemoving) {
+    importRemove();
+  } else if (_export_cursor != kExportDone && _sender->pending() == 0) {
+    exportRecord();
+  }
+  if (_out_pending == 0) {
+    return;
+  }
+
+  MidiSysExWriter writer;
+  writer.init(_export_buf, _channel);
+  writer.write({_out_buf, _out_pending});
+  writer.finish();
+  _out_pending = 0;
+  _sender->sendSysEx(writer.buffer());
+}
+
 }
@@ -1,27 +1,53 @@
 #pragma once
 
 #include <config.h>
+#include <midi_sender.h>
+#include <midi_sysex.h>
 
 #include <cstdio>
 #include <cstdint>
 #include <span>
 #include <array>
+#include <bitset>
 
 namespace tocata
 {
 class ConfigProtocol
 {
 public:
+  // Runtime figures for the host to watch; counters and maxima cover the
+  // time since the previous kGetDiagnostics
+  struct Diagnostics
+  {
+    uint32_t uptime_ms;
+    uint32_t frame_budget_us;
+    uint32_t frame_last_us;
+    uint32_t frame_max_us;
+    uint32_t frame_avg_us;
+    uint16_t frames_rendered;
+    uint16_t frames_skipped;
+    uint8_t frame_divider;   // animation frames drawn: 1 in frame_divider
+    uint32_t clock_late_max_us;   // worst MIDI clock tick, after its due time
+    uint16_t clock_ticks;
+    uint16_t clock_deferred;      // ticks the alarm left to the main loop
+  } __attribute__((packed));
+
   class Delegate
   {
     public:
       virtual void configChanged() = 0;
       virtual void programChanged(uint8_t id) = 0;
+      virtual void getDiagnostics(Diagnostics& diagnostics) = 0;
   };
 
   ConfigProtocol(Delegate& delegate) : _delegate(delegate) {}
 
-  std::span<const uint8_t> processSysEx(std::span<const uint8_t> sysex, std::span<uint8_t> buffer, uint8_t channel);
+  std::span<const uint8_t> processSysEx(std::span<const uint8_t> sysex, std::span<uint8_t> buffer, uint8_t channel, MidiSender& sender);
+  // Sends the next kExport record once the sender has drained the previous one,
+  // or deletes the next item a finished kImport left out
+  void run();
+  // Work left for run() that no interrupt will wake the loop for
+  bool busy() const { return _import_state == kImportRemoving; }
 
 private:
   static constexpr size_t kBuffSize = 512;
@@ -50,9 +76,12 @@ private:
     kGetSetlist = 0x0B,
     kSetSetlist = 0x0C,
     kDeleteSetlist = 0x0D,
+    kExport = 0x0E,
+    kImport = 0x0F,
     kMemRead = 0x10,
     kMemWrite = 0x11,
     kFlashErase = 0x12,
+    kGetDiagnostics = 0x13,
   };
 
   enum Status
@@ -64,6 +93,7 @@ private:
     kInvalidAddress = 4,
     kInvalidPayloadLength = 5,
     kInvalidSetlistId = 6,
+    kStorageFull = 7,        // the filesystem refused a save: the stored item is unchanged
   };
 
   struct ConfigReqRes
@@ -97,6 +127,53 @@ private:
     ProgramName names[];
   } __attribute__((packed));
 
+  // One item of a bulk export or import. kExport answers with a stream of
+  // these, config first and kRecordEnd last. kImport takes one per message,
+  // between kRecordBegin and kRecordEnd, which deletes every program and
+  // setlist the import didn't include. Only kRecordBegin is answered on its
+  // own: the host then streams records without waiting, keeping no more than
+  // ImportAck::window unacknowledged, and the device acknowledges every
+  // kImportAckEvery records and kRecordEnd, the latter once the deletions are
+  // done. An error answers the record that caused it and ends the import;
+  // records still in flight are dropped. A record the filesystem has no room
+  // for is refused with kStorageFull.
+  enum RecordType : uint8_t
+  {
+    kRecordBegin = 0,
+    kRecordConfig = 1,   // ConfigReqRes
+    kRecordProgram = 2,  // IdAndProgram
+    kRecordSetlist = 3,  // IdAndSetlist
+    kRecordEnd = 4,
+  };
+
+  struct Record
+  {
+    RecordType type;
+    uint8_t data[];
+  } __attribute__((packed));
+
+  struct ImportAck
+  {
+    uint16_t applied;  // records since kRecordBegin, kRecordEnd included
+    uint8_t window;
+  } __attribute__((packed));
+
+  // Records the host may have in flight. The USB endpoint holds them off
+  // with NAKs while the device is busy writing flash, so this only bounds how
+  // far ahead of an error the host can get.
+  static constexpr uint8_t kImportWindow = 8;
+  static constexpr uint8_t kImportAckEvery = kImportWindow / 2;
+
+  enum ImportState : uint8_t
+  {
+    kImportIdle,
+    kImportActive,
+    // A record was refused: drop the rest of the window until a new request
+    kImportRejected,
+    // kRecordEnd arrived: run() deletes what wasn't imported, one item a pass
+    kImportRemoving,
+  };
+
   struct AddressAndLength
   {
     uint32_t address;
@@ -132,6 +209,7 @@ private:
   using MemReadRes = AddressAndPayload;
   using MemWriteReq = AddressAndPayload;
   using FlashEraseReq = AddressAndLength;
+  using GetDiagnosticsRes = Diagnostics;
 
   void processRequest();
   void sendResponse(uint16_t length, Status status = kOk);
@@ -149,11 +227,37 @@ private:
   void getSetlist();
   void setSetlist();
   void deleteSetlist();
+  void exportAll();
+  void exportRecord();
+  void importRecord();
+  void importAck();
+  void importReject(Status status);
+  void importRemove();
   void memRead();
   void memWrite();
   void flashErase();
+  void getDiagnostics();
+
+  // Export cursor: the config, then programs, then setlists
+  static constexpr uint8_t kExportPrograms = 1;
+  static constexpr uint8_t kExportSetlists = kExportPrograms + Program::kMaxPrograms;
+  static constexpr uint8_t kExportEnd = kExportSetlists + Setlist::kMaxSetlists;
+  static constexpr uint8_t kExportDone = kExportEnd + 1;
+
+  // Removal cursor: programs, then setlists
+  static constexpr uint8_t kRemoveSetlists = Program::kMaxPrograms;
+  static constexpr uint8_t kRemoveDone = kRemoveSetlists + Setlist::kMaxSetlists;
 
   Delegate& _delegate;
+  MidiSender* _sender = nullptr;
+  uint8_t _channel = 0;
+  uint8_t _export_cursor = kExportDone;
+  std::bitset<Program::kMaxPrograms> _imported_programs;
+  std::bitset<Setlist::kMaxSetlists> _imported_setlists;
+  ImportState _import_state = kImportIdle;
+  uint16_t _import_applied = 0;
+  uint8_t _remove_cursor = kRemoveDone;
+  std::array<uint8_t, kMidiSysExMaxSize> _export_buf;
   uint8_t* _out_buf;
   uint32_t _out_pending = 0;
   uint32_t _in_length = 0;
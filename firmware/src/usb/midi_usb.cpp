@@ -1,6 +1,7 @@
 #include "midi_usb.h"
 #include "hal.h"
 #include <array>
+#include <cstdio>
 #include "midi_sysex.h"
 
 namespace tocata
@@ -8,62 +9,62 @@ namespace tocata
 
 void MidiUsb::sendProgram(uint8_t channel, uint8_t program)
 {
-  _write_offset = 0;
-  usb_midi_write(0xC0 | (channel & 0x0F), program);
+  const uint8_t message[] = {uint8_t(0xC0 | (channel & 0x0F)), program};
+  sendMessage(message);
 }
 
 void MidiUsb::sendControl(uint8_t channel, uint8_t control, uint8_t value)
 {
-  _write_offset = 0;
-  usb_midi_write(0xB0 | (channel & 0x0F), control, value);
+  const uint8_t message[] = {uint8_t(0xB0 | (channel & 0x0F)), control, value};
+  sendMessage(message);
 }
 
 void MidiUsb::sendSysEx(std::span<const uint8_t> sysex)
 {
-  std::copy(sysex.begin(), sysex.end(), _buffer.begin());
-  _write_size = sysex.size();
-  _write_offset = 0;
-  sendBytes();
+  sendMessage(sysex);
 }
 
 void MidiUsb::run()
 {
   while (usb_midi_available()) {
-    _write_size = _write_offset = 0;
-    auto bytes_read = usb_midi_stream_read(_buffer.data() + _read_offset, readAvailable());
+    auto bytes_read = usb_midi_stream_read(_read_buffer.data(), _read_buffer.size());
     if (bytes_read == 0) {
       break;
     }
 
-    if (_read_offset == 0 && _buffer[0] != 0xF0) {
-      _callback({_buffer.data(), bytes_read}, _buffer, *this);
-      break;
-    }
-
-    _read_offset += bytes_read;
-    if (_buffer[_read_offset - 1] == 0xF7) {
-      _callback({_buffer.data(), _read_offset}, _buffer, *this);
-      _read_offset = 0;
-    }
+    _parser.parse({_read_buffer.data(), bytes_read}, [this](std::span<const uint8_t> message) {
+      _callback(message, _buffer, *this);
+    });
   }
   sendBytes();
 }
 
-void MidiUsb::sendBytes()
+void MidiUsb::sendMessage(std::span<const uint8_t> message)
 {
-  if (writePending() == 0) {
+  if (!_tx.write(message)) {
+    ++_dropped;
+    printf("USB MIDI queue full, dropped %zu bytes (%zu total drops)\n", message.size(), _dropped);
     return;
   }
+  sendBytes();
+}
 
-  size_t sent;
-  while ((sent = usb_midi_write(_buffer.data() + _write_offset, writePending()))) {
-    _write_offset += sent;
+void MidiUsb::sendBytes()
+{
+  // Nobody to deliver to: don't replay stale messages once a host appears
+  if (!usb_midi_connected()) {
+    _tx.consume(_tx.size());
+    return;
   }
 
-  if (writePending() == 0) {
-    _write_offset = 0;
-    _write_size = 0;
+  while (!_tx.empty()) {
+    auto chunk = _tx.peek();
+    auto sent = usb_midi_write(chunk.data(), chunk.size());
+    if (sent == 0) {
+      break;
+    }
+    _tx.consume(sent);
   }
 }
 
-}
\ No newline at end of file
+}
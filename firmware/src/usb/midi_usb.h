@@ -5,6 +5,8 @@
 #include <cstdint>
 #include "midi_sender.h"
 #include "midi_sysex.h"
+#include "midi_parser.h"
+#include "spsc_ring.h"
 
 namespace tocata
 {
@@ -16,20 +18,28 @@ public:
 	void sendProgram(uint8_t channel, uint8_t program) override;
 	void sendControl(uint8_t channel, uint8_t control, uint8_t value) override;
 	void sendSysEx(std::span<const uint8_t> sysex) override;
+  void sendMessage(std::span<const uint8_t> message) override;
   void setCallback(Callback callback) override { _callback = callback; }
+  size_t pending() const override { return _tx.size(); }
+  size_t dropped() const override { return _dropped; }
 
 private:
+  // Room for a few full config responses plus the action messages queued
+  // around them while the host is slow to drain the TinyUSB FIFO
+  static constexpr size_t kTxSize = 2048;
+  static_assert(kTxSize >= 2 * kMidiSysExMaxSize);
+
   void sendBytes();
-  size_t writePending() { return _write_size - _write_offset; }
-  size_t readAvailable() { return _buffer.size() - _read_offset; }
 
   Callback _callback{};
-  size_t _write_size{0};
-  size_t _write_offset{0};
-  size_t _read_offset{0};
+  size_t _dropped{0};
+  SpscRing<kTxSize> _tx;
+  MidiParser _parser;
+  // One full-speed USB bulk packet
+  std::array<uint8_t, 64> _read_buffer;
+  // Scratch space for SysEx responses, queued by sendSysEx()
   std::array<uint8_t, kMidiSysExMaxSize> _buffer;
 };
 
 }
 
-
@@ -35,6 +35,7 @@ void UsbDevice::run()
   usb_run();
   blink();
   _midi.run();
+  _config.run();
 }
 
 void UsbDevice::blink()
@@ -0,0 +1,265 @@
+#include <controller.h>
+#include <hal.h>
+#include <headless.h>
+#include <headless_seed.h>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Plays the Controller on the headless HAL through every screen it shows --
+// with switch presses and MIDI, like a player and a host would -- and compares
+// each against a golden image in TOCATA_GOLDEN_DIR, pixel for pixel, as the
+// SSD1322/SH1106 decoders of the SDL build see it. One pedal per process, since
+// the Controller is one per process too:
+//
+//   display_snapshot_test [long|short]
+//
+// A missing or different golden fails the test. TOCATA_UPDATE_GOLDEN=1
+// records them all instead, after an intended change. The bytes sent to the
+// display for every screen, and the slowest frame drawn for it, are printed,
+// so a rendering optimisation can be checked to keep the pixels and measured
+// in the same run. Frames are timed on the host clock: on the headless HAL,
+// micros() -- and so Display::takeStats() -- is virtual time.
+
+using namespace tocata;
+
+namespace {
+
+// The Controller's display period: one frame per step
+constexpr uint64_t kFrameUs = 33333;
+constexpr uint64_t kHoldUs = 80000;
+constexpr uint8_t kMidiChannel = 0;
+constexpr uint8_t kTunerModeCc = 45;
+
+// Slowest pass that sent the display a frame, since the previous snapshot
+uint32_t render_max_us = 0;
+
+void runUntil(Controller& controller, uint64_t end_us)
+{
+    while (headless::now() < end_us)
+    {
+        const uint64_t bytes = headless::displayBytes();
+        const auto start = std::chrono::steady_clock::now();
+        controller.run();
+        if (headless::displayBytes() != bytes)
+        {
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+            const auto us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+            render_max_us = std::max(render_max_us, uint32_t(us));
+        }
+        const uint32_t now = micros();
+        const int32_t to_deadline = static_cast<int32_t>(controller.deadline() - now);
+        const int32_t to_end = int32_t(std::min<uint64_t>(end_us - headless::now(), INT32_MAX));
+        idle_until(now + uint32_t(std::max(0, std::min(to_deadline, to_end))));
+    }
+}
+
+void runFrames(Controller& controller, uint32_t frames)
+{
+    runUntil(controller, headless::now() + frames * kFrameUs);
+}
+
+// Press and release, leaving a frame for the new screen
+void press(Controller& controller, uint8_t sw)
+{
+    const uint64_t start = headless::now();
+    headless::setSwitches(start, 1u << sw);
+    headless::setSwitches(start + kHoldUs, 0);
+    runUntil(controller, start + kHoldUs + kFrameUs);
+}
+
+void send(Controller& controller, std::initializer_list<uint8_t> message)
+{
+    headless::sendMidi(headless::now(), std::vector<uint8_t>(message));
+    runFrames(controller, 1);
+}
+
+// The tuner's Note On: one semitone up and cents from -64 when the velocity
+// is over 63
+void tunerNote(Controller& controller, uint8_t note, int8_t cents)
+{
+    if (cents < 0)
+    {
+        send(controller, {uint8_t(0x90 | kMidiChannel), uint8_t(note - 1), uint8_t(cents + 128)});
+    }
+    else
+    {
+        send(controller, {uint8_t(0x90 | kMidiChannel), note, uint8_t(cents)});
+    }
+}
+
+// Plain PBM: one character per pixel, so a changed golden diffs readably
+std::string toPbm(const std::vector<uint8_t>& pixels, size_t cols, size_t rows)
+{
+    std::ostringstream out;
+    out << "P1\n" << cols << " " << rows << "\n";
+    for (size_t row = 0; row < rows; ++row)
+    {
+        for (size_t col = 0; col < cols; ++col)
+        {
+            out << (pixels[row * cols + col] ? '1' : '0');
+        }
+        out << '\n';
+    }
+    return out.str();
+}
+
+bool checkGolden(const std::string& name, const std::string& image)
+{
+    const std::filesystem::path dir{TOCATA_GOLDEN_DIR};
+    const auto path = dir / (name + ".pbm");
+    if (std::getenv("TOCATA_UPDATE_GOLDEN"))
+    {
+        std::filesystem::create_directories(dir);
+        std::ofstream{path} << image;
+        printf("  recorded %s\n", path.c_str());
+        return true;
+    }
+
+    std::ifstream in{path};
+    if (!in)
+    {
+        printf("  MISSING %s, record it with TOCATA_UPDATE_GOLDEN=1\n", path.c_str());
+        return false;
+    }
+    std::stringstream golden;
+    golden << in.rdbuf();
+    if (golden.str() == image)
+    {
+        return true;
+    }
+    const auto actual = std::filesystem::temp_directory_path() / (name + ".actual.pbm");
+    std::ofstream{actual} << image;
+    printf("  MISMATCH %s, rendered %s\n", path.c_str(), actual.c_str());
+    return false;
+}
+
+class Snapshots
+{
+public:
+    explicit Snapshots(const char* pedal) : _pedal(pedal)
+    {
+        printf("%-6s %-22s %10s %10s\n", "pedal", "screen", "bytes", "max_us");
+    }
+
+    // Checks the screen as it is now and returns its image
+    std::string check(const char* screen)
+    {
+        std::vector<uint8_t> pixels;
+        headless::copyFramebuffer(pixels);
+        const DisplaySim& sim = headless::display();
+        const auto image = toPbm(pixels, sim.numColumns(), sim.numRows());
+
+        const uint64_t bytes = headless::displayBytes();
+        printf("%-6s %-22s %10llu %10u\n", _pedal, screen, (unsigned long long)(bytes - _bytes), render_max_us);
+        _bytes = bytes;
+        render_max_us = 0;
+        // Something has to have been drawn for the snapshot to mean anything
+        assert(std::find(pixels.begin(), pixels.end(), 1) != pixels.end());
+
+        _passed &= checkGolden(std::string(_pedal) + "_" + screen, image);
+        return image;
+    }
+
+    bool passed() const { return _passed; }
+
+private:
+    const char* _pedal;
+    uint64_t _bytes = 0;
+    bool _passed = true;
+};
+
+}
+
+int main(int argc, char** argv)
+{
+    const bool is_long = argc < 2 || strcmp(argv[1], "short") != 0;
+    headless::setPedalLong(is_long);
+    // The Controller's menus, which depend on the pedal size
+    const uint8_t half = is_long ? 4 : 3;
+    const uint8_t last = is_long ? 7 : 5;
+
+    Storage::init();
+    headless::seedFlash();
+
+    // Switches and LEDs in order; the pins mean nothing to the headless HAL
+    static HWConfig hw_config{};
+    std::iota(std::begin(hw_config.switches.map), std::end(hw_config.switches.map), 0);
+    std::iota(std::begin(hw_config.leds.map), std::end(hw_config.leds.map), 0);
+    headless::setExpressionConnected(true);
+    headless::setExpression(0, 2048);
+    static Controller controller{hw_config};
+    controller.init();
+    runFrames(controller, 2);
+
+    Snapshots snapshots{is_long ? "long" : "short"};
+
+    // Two stomps on, one in each row
+    press(controller, 0);
+    press(controller, uint8_t(half + 1));
+    snapshots.check("footswitch");
+
+    // The seeded long name, still, then after the scroll's initial delay
+    // and enough frames to move it a few letters
+    send(controller, {uint8_t(0xC0 | kMidiChannel), headless::kLongNameProgram});
+    const auto still = snapshots.check("long_name");
+    runFrames(controller, 40);
+    const auto scrolled = snapshots.check("scrolled_name");
+    assert(scrolled != still);
+    send(controller, {uint8_t(0xC0 | kMidiChannel), 0});
+
+    // The seed's program switch opens the program change menu, whose number
+    // blinks every 8 frames
+    press(controller, last);
+    const auto program_change = snapshots.check("program_change");
+    runFrames(controller, 8);
+    const auto blink = snapshots.check("program_change_blink");
+    assert(blink != program_change);
+
+    // SETUP, then SETLISTS, then LOAD the setlist already selected
+    press(controller, 2);
+    snapshots.check("setup");
+    press(controller, uint8_t(half - 1));
+    snapshots.check("setlist");
+    press(controller, last);
+
+    // The tuner as the host drives it
+    send(controller, {uint8_t(0xB0 | kMidiChannel), kTunerModeCc, 127});
+    snapshots.check("tuner_no_note");
+    const struct
+    {
+        const char* screen;
+        uint8_t note;
+        int8_t cents;
+    } kNotes[] = {
+        {"tuner_flat_50", 69, -50},
+        {"tuner_flat_10", 69, -10},
+        {"tuner_in_tune", 69, 0},
+        {"tuner_sharp_3", 64, 3},
+        {"tuner_sharp_10", 69, 10},
+        {"tuner_sharp_50", 40, 50},
+    };
+    for (const auto& note : kNotes)
+    {
+        tunerNote(controller, note.note, note.cents);
+        snapshots.check(note.screen);
+    }
+
+    if (!snapshots.passed())
+    {
+        printf("display_snapshot_test FAILED\n");
+        return 1;
+    }
+    printf("display_snapshot_test passed\n");
+    return 0;
+}
@@ -0,0 +1,208 @@
+#include <config.h>
+#include <filesystem.h>
+#include <flash_sim.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace tocata;
+
+// Host HAL flash on the NOR model, swapped for a fresh chip per scenario
+namespace tocata {
+
+static FlashSim* sFlash = nullptr;
+
+void flash_read(uint32_t flash_offs, void* dst, size_t count) { sFlash->read(flash_offs, dst, count); }
+void flash_write(uint32_t flash_offs, const void* data, size_t count) { sFlash->program(flash_offs, data, count); }
+void flash_erase(uint32_t flash_offs, size_t count) { sFlash->erase(flash_offs, count); }
+
+}
+
+namespace {
+
+// The filesystem's block, its unit of compaction
+constexpr uint32_t kBlockSize = 64 * 1024;
+
+// Setlist keeps its contents to itself and its subclasses
+class BenchSetlist : public Setlist
+{
+public:
+    void fill(uint32_t seed)
+    {
+        snprintf(_name, sizeof(_name), "Set %u", seed);
+        _num_programs = uint8_t(1 + seed % Program::kMaxPrograms);
+        for (uint8_t pos = 0; pos < _num_programs; ++pos)
+        {
+            _programs[pos] = uint8_t((seed + pos * 7) % Program::kMaxPrograms);
+        }
+    }
+};
+
+// Only the name is filled in, through the packed layout the USB protocol
+// and legacy files share, where it comes first: each save still goes
+// through the compact encoder, with a size that varies with the name
+void fillProgram(Program& program, uint32_t seed)
+{
+    memset(static_cast<void*>(&program), 0, sizeof(program));
+    char* name = reinterpret_cast<char*>(&program);
+    snprintf(name, Program::kMaxNameLength + 1, "%.*s %u", int(seed % 20), "Program name padding", seed);
+}
+
+struct Scenario
+{
+    const char* name;
+    // Storage::run passes between two saves: the controller runs one every
+    // 10 ms, so a user editing on the pedal leaves plenty, a bulk import none
+    uint32_t background_passes;
+};
+
+struct Geometry
+{
+    const char* name;
+    uint32_t blocks;  // one of them the spare
+};
+
+void run(const Geometry& geometry, const Scenario& scenario, uint32_t operations)
+{
+    const uint32_t partition_size = geometry.blocks * kBlockSize;
+    // Only as much chip as the partition needs
+    FlashSim flash{kFlashPartitionOffset + partition_size};
+    const bool opened = flash.open();
+    if (!opened)
+    {
+        printf("Cannot map the flash image\n");
+        exit(1);
+    }
+    sFlash = &flash;
+    TocataFS.setPartition(FlashPartition{kFlashPartitionOffset, partition_size});
+    Storage::init();
+
+    const auto start_flash = flash.stats();
+    uint64_t assist_total_us = 0;
+    uint64_t assist_max_us = 0;
+    uint64_t op_max_us = 0;
+
+    // Fixed seed: every run does the same operations
+    uint32_t random = 12345;
+    auto next = [&random]() {
+        random = random * 1103515245u + 12345u;
+        return random >> 8;
+    };
+
+    Program program;
+    BenchSetlist setlist;
+    Config config;
+    config.load();
+
+    using Clock = std::chrono::steady_clock;
+    const auto wall_start = Clock::now();
+    for (uint32_t op = 0; op < operations; ++op)
+    {
+        const uint64_t busy_before = flash.stats().busy_us;
+        const uint32_t assists_before = TocataFS.stats().assists;
+
+        const uint32_t kind = next() % 100;
+        const uint32_t seed = next();
+        if (kind < 55)
+        {
+            fillProgram(program, seed);
+            program.save(uint8_t(seed % Program::kMaxPrograms));
+        }
+        else if (kind < 75)
+        {
+            setlist.fill(seed);
+            setlist.save(uint8_t(seed % Setlist::kMaxSetlists));
+        }
+        else if (kind < 85)
+        {
+            // An expression calibration
+            config.expression().setMinRaw(uint16_t(seed % 512));
+            config.save();
+        }
+        else
+        {
+            Program::remove(uint8_t(seed % Program::kMaxPrograms));
+        }
+
+        const uint64_t busy_us = flash.stats().busy_us - busy_before;
+        op_max_us = std::max(op_max_us, busy_us);
+        if (TocataFS.stats().assists != assists_before)
+        {
+            assist_total_us += busy_us;
+            assist_max_us = std::max(assist_max_us, busy_us);
+        }
+
+        for (uint32_t pass = 0; pass < scenario.background_passes; ++pass)
+        {
+            Storage::run();
+        }
+    }
+    const std::chrono::duration<double> wall = Clock::now() - wall_start;
+
+    const auto& fs = TocataFS.stats();
+    const uint64_t programmed = (flash.stats().pages_programmed - start_flash.pages_programmed) * kFlashPageSize;
+    const uint64_t erased = flash.stats().sectors_erased - start_flash.sectors_erased;
+
+    uint32_t min_erases = UINT32_MAX;
+    uint32_t max_erases = 0;
+    uint64_t total_erases = 0;
+    const size_t first_sector = kFlashPartitionOffset / kFlashSectorSize;
+    const size_t num_sectors = partition_size / kFlashSectorSize;
+    for (size_t sector = first_sector; sector < first_sector + num_sectors; ++sector)
+    {
+        const uint32_t erases = flash.eraseCount(sector);
+        min_erases = std::min(min_erases, erases);
+        max_erases = std::max(max_erases, erases);
+        total_erases += erases;
+    }
+
+    printf("--- %s, %s: %u operations, %u background passes each\n",
+        geometry.name, scenario.name, operations, scenario.background_passes);
+    printf("host:       %.0f operations/s\n", operations / wall.count());
+    printf("writes:     %u files, %u bytes of content, %llu bytes programmed, %llu sectors erased\n",
+        fs.files_created, fs.bytes_written, (unsigned long long)programmed, (unsigned long long)erased);
+    printf("write amp:  %.2f programmed, %.2f including erases\n",
+        fs.bytes_written ? double(programmed) / fs.bytes_written : 0.0,
+        fs.bytes_written ? double(programmed + erased * kFlashSectorSize) / fs.bytes_written : 0.0);
+    printf("compaction: %u blocks, %u files copied, %u assisted writes (mean %.1f ms, max %.1f ms), %u refused\n",
+        fs.collections, fs.files_copied, fs.assists,
+        fs.assists ? assist_total_us / 1000.0 / fs.assists : 0.0, assist_max_us / 1000.0, fs.refused);
+    printf("busy:       %.1f s of flash time, slowest operation %.1f ms\n",
+        (flash.stats().busy_us - start_flash.busy_us) / 1e6, op_max_us / 1000.0);
+    printf("wear:       %u..%u erases per sector, mean %.1f, spread %u\n",
+        min_erases, max_erases, double(total_erases) / num_sectors, max_erases - min_erases);
+}
+
+}
+
+// Drives program, setlist and config saves and program removals through the
+// real storage code onto the simulated NOR flash. Reports how many bytes
+// reach the flash for each byte saved, how much compaction work saves had to
+// do themselves, how many were turned away, and how evenly the sectors wear.
+// Runs on the board's four blocks, then on two: the least the filesystem
+// works with, as a worst case for compaction and wear.
+//   flash_bench [operations]
+int main(int argc, char** argv)
+{
+    const uint32_t operations = argc > 1 ? uint32_t(strtoul(argv[1], nullptr, 0)) : 5000;
+
+    const Scenario scenarios[] = {
+        {"editing", 10},
+        {"import", 0},
+    };
+    const Geometry geometries[] = {
+        {"board, 4 blocks", kFlashPartitionSize / kBlockSize},
+        {"worst case, 2 blocks", 2},
+    };
+    for (const auto& geometry : geometries)
+    {
+        for (const auto& scenario : scenarios)
+        {
+            run(geometry, scenario, operations);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,124 @@
+#include <led_effects.h>
+
+#include <cassert>
+#include <cstdio>
+#include <vector>
+
+using namespace tocata;
+
+// Host HAL pieces Leds needs, without the simulator behind them
+namespace tocata {
+
+bool is_pedal_long() { return true; }
+
+static std::vector<std::vector<uint32_t>> frames;
+
+void leds_refresh(const HWConfigLeds&, const uint32_t* leds, size_t num_leds)
+{
+    frames.emplace_back(leds, leds + num_leds);
+}
+
+}
+
+namespace {
+
+const HWConfigLeds kConfig = {.state_machine_id = 1, .data_pin = 0, .map = {0, 1, 2, 3, 4, 5, 6, 7}};
+
+uint32_t grb(uint8_t r, uint8_t g, uint8_t b)
+{
+    return (g << 24) | (r << 16) | (b << 8);
+}
+
+// Runs a tick at `now` and returns the frame it sent, if any
+bool tick(LedEffects& effects, Leds& leds, uint32_t now)
+{
+    const size_t sent = frames.size();
+    effects.tick(now);
+    leds.run();
+    return frames.size() > sent;
+}
+
+void testFade()
+{
+    Leds leds{kConfig};
+    LedEffects effects{leds};
+    effects.fade(2, {0, 0, 0}, {100, 50, 0}, 100);
+    const uint32_t start = millis();
+    assert(tick(effects, leds, start));
+    assert(frames.back()[2] == grb(0, 0, 0));
+    assert(tick(effects, leds, start + 50));
+    assert(frames.back()[2] == grb(50, 25, 0));
+    assert(tick(effects, leds, start + 100));
+    assert(frames.back()[2] == grb(100, 50, 0));
+    // Done: holds the final color, nothing more to send
+    assert(!tick(effects, leds, start + 200));
+}
+
+void testBlink()
+{
+    Leds leds{kConfig};
+    LedEffects effects{leds};
+    effects.blink(0, {128, 0, 0}, {2, 0, 0}, 500, 125);
+    const uint32_t start = millis();
+    tick(effects, leds, start);
+    assert(frames.back()[0] == grb(128, 0, 0));
+    // Unchanged frames aren't sent again
+    assert(!tick(effects, leds, start + 100));
+    assert(tick(effects, leds, start + 130));
+    assert(frames.back()[0] == grb(2, 0, 0));
+    assert(tick(effects, leds, start + 510));
+    assert(frames.back()[0] == grb(128, 0, 0));
+
+    effects.stop(0);
+    assert(!tick(effects, leds, start + 700));
+}
+
+void testPulse()
+{
+    Leds leds{kConfig};
+    LedEffects effects{leds};
+    effects.pulse(1, {0, 0, 128}, 1000);
+    const uint32_t start = millis();
+    tick(effects, leds, start);
+    assert(frames.back()[1] == grb(0, 0, 0));
+    tick(effects, leds, start + 500);
+    assert(frames.back()[1] == grb(0, 0, 128));
+    // Gamma: half way up is much less than half as bright
+    tick(effects, leds, start + 250);
+    assert(frames.back()[1] < grb(0, 0, 40) && frames.back()[1] > grb(0, 0, 0));
+}
+
+void testMeter()
+{
+    Leds leds{kConfig};
+    LedEffects effects{leds};
+    // In tune: the two middle columns, top and bottom row
+    effects.meter(60, 0);
+    assert(tick(effects, leds, millis()));
+    const auto& frame = frames.back();
+    for (uint8_t led = 0; led < 8; ++led) {
+        const bool middle = led % 4 == 1 || led % 4 == 2;
+        assert(frame[led] == (middle ? grb(0, 128, 0) : 0));
+    }
+
+    // Several updates between ticks still cost one frame
+    const size_t sent = frames.size();
+    effects.meter(60, -30);
+    effects.meter(60, -64);
+    tick(effects, leds, millis());
+    assert(frames.size() == sent + 1);
+    assert(frames.back()[0] == grb(128, 0, 0));
+    assert(frames.back()[3] == 0);
+}
+
+}
+
+int main()
+{
+    testFade();
+    testBlink();
+    testPulse();
+    testMeter();
+    printf("led_effects_test passed\n");
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include <midi_parser.h>
+
+#include <cassert>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace tocata;
+
+namespace {
+
+using Messages = std::vector<std::vector<uint8_t>>;
+
+Messages parse(MidiParser& parser, const std::vector<uint8_t>& input, size_t chunk = 0)
+{
+    Messages messages;
+    auto handler = [&](std::span<const uint8_t> message) {
+        messages.emplace_back(message.begin(), message.end());
+    };
+    if (chunk == 0)
+    {
+        parser.parse(input, handler);
+        return messages;
+    }
+    for (size_t offset = 0; offset < input.size(); offset += chunk)
+    {
+        parser.parse({input.data() + offset, std::min(chunk, input.size() - offset)}, handler);
+    }
+    return messages;
+}
+
+void testRunningStatus()
+{
+    MidiParser parser;
+    auto messages = parse(parser, {0xB0, 32, 1, 43, 2, 0xC3, 5, 6});
+    assert((messages == Messages{{0xB0, 32, 1}, {0xB0, 43, 2}, {0xC3, 5}, {0xC3, 6}}));
+}
+
+void testRealtimeInsideMessages()
+{
+    MidiParser parser;
+    auto messages = parse(parser, {0xF0, 0x00, 0xF8, 0x2F, 0x7F, 0xFE, 0xF7, 0xB0, 0xF8, 1, 2});
+    assert((messages == Messages{{0xF8}, {0xFE}, {0xF0, 0x00, 0x2F, 0x7F, 0xF7}, {0xF8}, {0xB0, 1, 2}}));
+}
+
+void testSplitReads()
+{
+    // Every possible chunking of the same stream yields the same messages
+    std::vector<uint8_t> input = {0xC0, 3, 0xF0, 1, 2, 3, 4, 5, 6, 0xF7, 0xF8, 0x90, 60, 100, 61, 0xF2, 1, 2, 7};
+    MidiParser reference;
+    auto expected = parse(reference, input);
+    assert((expected == Messages{{0xC0, 3}, {0xF0, 1, 2, 3, 4, 5, 6, 0xF7}, {0xF8}, {0x90, 60, 100}, {0xF2, 1, 2}}));
+    for (size_t chunk = 1; chunk <= input.size(); ++chunk)
+    {
+        MidiParser parser;
+        assert(parse(parser, input, chunk) == expected);
+    }
+}
+
+void testDroppedSysEx()
+{
+    MidiParser parser;
+    // A status byte aborts an unterminated SysEx; stray data is ignored
+    auto messages = parse(parser, {5, 6, 0xF0, 1, 2, 0xC0, 9, 0xF7});
+    assert((messages == Messages{{0xC0, 9}}));
+
+    std::vector<uint8_t> big(MidiParser::kMaxMessageSize + 10, 0x11);
+    big.front() = 0xF0;
+    big.back() = 0xF7;
+    assert(parse(parser, big).empty());
+    assert((parse(parser, {0xC1, 4}) == Messages{{0xC1, 4}}));
+}
+
+void testFuzz()
+{
+    // Random streams only check invariants: well-formed, complete messages
+    std::mt19937 rng(7);
+    MidiParser parser;
+    for (int iteration = 0; iteration < 2000; ++iteration)
+    {
+        std::vector<uint8_t> input(rng() % 256);
+        for (auto& b : input)
+        {
+            b = (rng() % 4 == 0) ? uint8_t(0x80 | rng()) : uint8_t(rng() & 0x7F);
+        }
+        for (const auto& message : parse(parser, input, rng() % 16 + 1))
+        {
+            assert(!message.empty() && (message[0] & 0x80));
+            if (message[0] == 0xF0)
+            {
+                assert(message.back() == 0xF7);
+            }
+            else
+            {
+                for (size_t i = 1; i < message.size(); ++i)
+                {
+                    assert(!(message[i] & 0x80));
+                }
+            }
+        }
+    }
+}
+
+}
+
+int main()
+{
+    testRunningStatus();
+    testRealtimeInsideMessages();
+    testSplitReads();
+    testDroppedSysEx();
+    testFuzz();
+    printf("midi_parser_test passed\n");
+    return 0;
+}
@@ -0,0 +1,148 @@
+#include <midi_router.h>
+
+#include <cassert>
+#include <cstdio>
+#include <vector>
+
+using namespace tocata;
+
+namespace {
+
+class RecordingSender : public MidiSender {
+public:
+    void sendProgram(uint8_t, uint8_t) override { assert(false); }
+    void sendControl(uint8_t, uint8_t, uint8_t) override { assert(false); }
+    void sendSysEx(std::span<const uint8_t>) override { assert(false); }
+    void sendMessage(std::span<const uint8_t> message) override {
+        messages.emplace_back(message.begin(), message.end());
+    }
+    void setCallback(Callback) override {}
+    size_t pending() const override { return messages.size(); }
+
+    std::vector<std::vector<uint8_t>> messages;
+};
+
+void testFanOut()
+{
+    RecordingSender usb;
+    RecordingSender net;
+    MidiRouter router;
+    assert(router.addDestination(usb));
+    assert(router.addDestination(net));
+    assert(!router.addDestination(net));
+
+    router.sendProgram(2, 10);
+    router.sendControl(15, 7, 100);
+    const uint8_t sysex[] = {0xF0, 0x7E, 0x01, 0xF7};
+    router.sendSysEx(sysex);
+
+    const std::vector<std::vector<uint8_t>> expected = {{0xC2, 10}, {0xBF, 7, 100}, {0xF0, 0x7E, 0x01, 0xF7}};
+    assert(usb.messages == expected);
+    assert(net.messages == expected);
+    assert(router.pending() == 3);
+}
+
+void testFilters()
+{
+    RecordingSender usb;
+    RecordingSender net;
+    MidiRouter router;
+    router.addDestination(usb, {.types = MidiRouter::Filter::kControl});
+    router.addDestination(net, {.channels = 1 << 3});
+
+    router.sendProgram(3, 1);
+    router.sendControl(3, 2, 3);
+    router.sendControl(4, 2, 3);
+    assert((usb.messages == std::vector<std::vector<uint8_t>>{{0xB3, 2, 3}, {0xB4, 2, 3}}));
+    assert((net.messages == std::vector<std::vector<uint8_t>>{{0xC3, 1}, {0xB3, 2, 3}}));
+
+    router.setFilter(net, {.types = 0});
+    router.sendControl(3, 2, 3);
+    assert(net.messages.size() == 2);
+
+    // Clock only reaches destinations that take realtime messages
+    const uint8_t clock[] = {0xF8};
+    router.setFilter(net, {.types = MidiRouter::Filter::kRealtime});
+    router.sendMessage(clock);
+    assert(usb.messages.size() == 3);
+    assert((net.messages.back() == std::vector<uint8_t>{0xF8}));
+}
+
+void testCoalescing()
+{
+    RecordingSender usb;
+    RecordingSender net;
+    MidiRouter router;
+    router.addDestination(usb, {}, 1000);
+    router.addDestination(net, {}, 200);
+    // Any time at least one interval after boot
+    constexpr uint32_t kStart = 100000;
+
+    // A sweep between flushes only leaves its last value
+    for (uint8_t value = 0; value < 128; ++value) {
+        router.latest().sendControl(0, 11, value);
+    }
+    assert(usb.messages.empty() && net.messages.empty());
+    router.run(kStart);
+    assert((usb.messages == std::vector<std::vector<uint8_t>>{{0xB0, 11, 127}}));
+    assert(net.messages == usb.messages);
+
+    // Within the interval nothing goes out, then the final value does
+    router.latest().sendControl(0, 11, 64);
+    router.run(kStart + 500);
+    assert(usb.messages.size() == 1 && net.messages.size() == 1);
+    router.run(kStart + 1000);
+    assert(usb.messages.size() == 2 && usb.messages.back()[2] == 64);
+    assert(net.messages.size() == 1);
+    router.run(kStart + 5000);
+    assert(net.messages.size() == 2 && net.messages.back()[2] == 64);
+
+    // Pending CCs go out in the order of their last update: an MSB after
+    // its LSB moves the LSB behind it
+    router.latest().sendControl(0, 32 + 4, 1);
+    router.latest().sendControl(0, 4, 2);
+    router.latest().sendControl(0, 32 + 4, 3);
+    router.run(kStart + 10000);
+    assert((std::vector(usb.messages.end() - 2, usb.messages.end()) ==
+            std::vector<std::vector<uint8_t>>{{0xB0, 4, 2}, {0xB0, 36, 3}}));
+
+    // Anything sent normally flushes what's pending first
+    router.latest().sendControl(0, 11, 1);
+    router.sendProgram(0, 5);
+    assert((std::vector(usb.messages.end() - 2, usb.messages.end()) ==
+            std::vector<std::vector<uint8_t>>{{0xB0, 11, 1}, {0xC0, 5}}));
+    router.run(kStart + 20000);
+    assert(usb.messages.back()[0] == 0xC0);
+}
+
+void testCoalescingFull()
+{
+    RecordingSender usb;
+    MidiRouter router;
+    router.addDestination(usb, {}, 100);
+    for (uint8_t control = 0; control < MidiRouter::kMaxCoalesced; ++control) {
+        router.latest().sendControl(1, control, 0);
+    }
+    assert(usb.messages.empty());
+    // No room: pending ones are flushed and this one is sent through
+    router.latest().sendControl(1, 100, 7);
+    assert(usb.messages.size() == MidiRouter::kMaxCoalesced + 1);
+    assert((usb.messages.back() == std::vector<uint8_t>{0xB1, 100, 7}));
+
+    // Without a rate, coalesced CCs aren't delayed
+    router.setMaxRate(usb, 0);
+    router.latest().sendControl(1, 11, 9);
+    assert(usb.messages.size() == MidiRouter::kMaxCoalesced + 2);
+}
+
+}
+
+int main()
+{
+    testFanOut();
+    testFilters();
+    testCoalescing();
+    testCoalescingFull();
+    printf("midi_router_test passed\n");
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include <scheduler.h>
+
+#include <cassert>
+#include <cstdio>
+
+using namespace tocata;
+
+namespace {
+
+void testPeriods()
+{
+    Scheduler scheduler;
+    int fast = 0;
+    int slow = 0;
+    assert(scheduler.every(1000, [&] { ++fast; }, 0));
+    assert(scheduler.every(4000, [&] { ++slow; }, 0));
+
+    // Both run on the first pass, then at their own cadence
+    scheduler.run(0);
+    assert(fast == 1 && slow == 1);
+    assert(scheduler.deadline(0) == 1000);
+    scheduler.run(999);
+    assert(fast == 1);
+
+    // A late pass doesn't shift the cadence
+    scheduler.run(1300);
+    assert(fast == 2 && slow == 1);
+    assert(scheduler.deadline(1300) == 2000);
+
+    // More than a period late: no burst, restart from now
+    scheduler.run(5500);
+    assert(fast == 3 && slow == 2);
+    assert(scheduler.deadline(5500) == 6500);
+    scheduler.run(6500);
+    assert(fast == 4);
+}
+
+void testWake()
+{
+    Scheduler scheduler;
+    // With nothing scheduled the sleep is still bounded
+    assert(scheduler.deadline(100) == 100 + 1000000);
+
+    int count = 0;
+    scheduler.every(10000, [&] { ++count; }, 0);
+    scheduler.run(0);
+    scheduler.wakeBy(3000);
+    scheduler.wakeBy(5000);
+    assert(scheduler.deadline(0) == 3000);
+    // Until the next run
+    scheduler.run(3000);
+    assert(count == 1);
+    assert(scheduler.deadline(3000) == 10000);
+}
+
+void testWrap()
+{
+    Scheduler scheduler;
+    int count = 0;
+    const uint32_t start = UINT32_MAX - 500;
+    scheduler.every(1000, [&] { ++count; }, start);
+    scheduler.run(start);
+    assert(scheduler.deadline(start) == start + 1000);
+    scheduler.run(start + 999);
+    assert(count == 1);
+    scheduler.run(start + 1000);
+    assert(count == 2);
+}
+
+void testCapacity()
+{
+    Scheduler scheduler;
+    for (size_t i = 0; i < Scheduler::kMaxTasks; ++i) {
+        assert(scheduler.every(1000, [] {}, 0));
+    }
+    assert(!scheduler.every(1000, [] {}, 0));
+}
+
+}
+
+int main()
+{
+    testPeriods();
+    testWake();
+    testWrap();
+    testCapacity();
+    printf("scheduler_test passed\n");
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include <spsc_ring.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace tocata;
+
+namespace {
+
+// The queue hal_host.cpp used before SpscRing, kept as the baseline
+class LockedDeque {
+public:
+    bool write(std::span<const uint8_t> data) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queue.insert(_queue.end(), data.begin(), data.end());
+        return true;
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _queue.size();
+    }
+
+    size_t read(std::span<uint8_t> output) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        size_t count = std::min(output.size(), _queue.size());
+        for (size_t i = 0; i < count; ++i) {
+            output[i] = _queue.front();
+            _queue.pop_front();
+        }
+        return count;
+    }
+
+private:
+    std::mutex _mutex;
+    std::deque<uint8_t> _queue;
+};
+
+// A show file replay: mostly 3 byte CCs and clock, with a config sized
+// SysEx every 64 messages. The consumer drains it like MidiUsb::run, polling
+// availability and reading one USB packet at a time.
+template <typename Queue>
+double ingest(Queue& queue, size_t messages)
+{
+    const uint8_t cc[3] = {0xB0, 43, 1};
+    const uint8_t clock[1] = {0xF8};
+    std::vector<uint8_t> sysex(600, 0x11);
+    sysex.front() = 0xF0;
+    sysex.back() = 0xF7;
+
+    size_t total = 0;
+    for (size_t i = 0; i < messages; ++i) {
+        total += (i % 64 == 0) ? sysex.size() : (i % 2) ? sizeof(cc) : sizeof(clock);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread producer([&] {
+        for (size_t i = 0; i < messages; ++i) {
+            std::span<const uint8_t> message = (i % 64 == 0) ? std::span<const uint8_t>(sysex)
+                                             : (i % 2) ? std::span<const uint8_t>(cc)
+                                             : std::span<const uint8_t>(clock);
+            while (!queue.write(message)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint8_t packet[64];
+    size_t received = 0;
+    while (received < total) {
+        if (queue.size() > 0) {
+            received += queue.read(packet);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return double(total) / 1e6 / elapsed.count();
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    const size_t messages = argc > 1 ? strtoul(argv[1], nullptr, 0) : 2000000;
+
+    LockedDeque deque;
+    printf("mutex + deque: %.1f MB/s\n", ingest(deque, messages));
+
+    static SpscRing<1 << 16> ring;
+    printf("spsc ring:     %.1f MB/s\n", ingest(ring, messages));
+    return 0;
+}
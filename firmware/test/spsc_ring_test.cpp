@@ -0,0 +1,132 @@
+#include <spsc_ring.h>
+
+#include <cassert>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace tocata;
+
+namespace {
+
+void testWrapAround()
+{
+    SpscRing<16> ring;
+    std::vector<uint8_t> out(16);
+    uint8_t next_in = 0;
+    uint8_t next_out = 0;
+    for (int i = 0; i < 100; ++i)
+    {
+        uint8_t in[7];
+        const size_t size = i % 7 + 1;
+        for (size_t j = 0; j < size; ++j)
+        {
+            in[j] = next_in++;
+        }
+        assert(ring.write({in, size}));
+        size_t count = ring.read({out.data(), size_t(i % 5 + 3)});
+        for (size_t j = 0; j < count; ++j)
+        {
+            assert(out[j] == next_out++);
+        }
+        // Drain whenever the next write might not fit
+        if (ring.free() < 8)
+        {
+            count = ring.read(out);
+            for (size_t j = 0; j < count; ++j)
+            {
+                assert(out[j] == next_out++);
+            }
+        }
+    }
+}
+
+void testAllOrNothing()
+{
+    SpscRing<8> ring;
+    const uint8_t data[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    assert(ring.write({data, 5}));
+    assert(!ring.write({data, 4}));
+    assert(ring.size() == 5);
+    assert(ring.write({data, 3}));
+    assert(ring.free() == 0);
+    assert(!ring.write({data, 1}));
+}
+
+void testPeekConsume()
+{
+    // peek() stops at the wrap point; consume() releases partial chunks
+    SpscRing<8> ring;
+    const uint8_t data[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    uint8_t out[8];
+    assert(ring.write({data, 6}));
+    assert(ring.read({out, 5}) == 5);
+    assert(ring.write({data, 6}));
+    auto chunk = ring.peek();
+    assert(chunk.size() == 3 && chunk[0] == 6 && chunk[1] == 1 && chunk[2] == 2);
+    ring.consume(1);
+    assert(ring.peek().size() == 2);
+    ring.consume(2);
+    chunk = ring.peek();
+    assert(chunk.size() == 4 && chunk[0] == 3 && chunk[3] == 6);
+    ring.consume(chunk.size());
+    assert(ring.empty() && ring.peek().empty());
+}
+
+void testThreads()
+{
+    // The producer writes a counting sequence in random sized pieces; the
+    // consumer must see it intact and in order
+    constexpr uint32_t kTotal = 1 << 22;
+    SpscRing<256> ring;
+
+    std::thread producer([&] {
+        std::mt19937 rng(5);
+        uint8_t chunk[32];
+        uint32_t sent = 0;
+        while (sent < kTotal)
+        {
+            size_t size = std::min<size_t>(rng() % sizeof(chunk) + 1, kTotal - sent);
+            for (size_t i = 0; i < size; ++i)
+            {
+                chunk[i] = uint8_t(sent + i);
+            }
+            while (!ring.write({chunk, size}))
+            {
+                std::this_thread::yield();
+            }
+            sent += uint32_t(size);
+        }
+    });
+
+    uint8_t out[48];
+    uint32_t received = 0;
+    while (received < kTotal)
+    {
+        size_t count = ring.read(out);
+        if (count == 0)
+        {
+            std::this_thread::yield();
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            assert(out[i] == uint8_t(received + i));
+        }
+        received += uint32_t(count);
+    }
+    producer.join();
+    assert(ring.empty());
+}
+
+}
+
+int main()
+{
+    testWrapAround();
+    testAllOrNothing();
+    testPeekConsume();
+    testThreads();
+    printf("spsc_ring_test passed\n");
+    return 0;
+}
@@ -0,0 +1,55 @@
+#include <midi_sysex.h>
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using namespace tocata;
+
+// Encodes and decodes a config sized payload in a loop, reporting the
+// throughput of each direction
+int main(int argc, char** argv)
+{
+    const size_t iterations = argc > 1 ? strtoul(argv[1], nullptr, 0) : 200000;
+    constexpr size_t kPayloadSize = 600;
+
+    std::vector<uint8_t> input(kPayloadSize);
+    for (size_t i = 0; i < input.size(); ++i)
+    {
+        input[i] = uint8_t(i * 37 + 5);
+    }
+    std::vector<uint8_t> sysex(MidiSysExWriter::bytesRequired(kPayloadSize));
+    std::vector<uint8_t> output(kPayloadSize);
+
+    using Clock = std::chrono::steady_clock;
+    uint32_t checksum = 0;
+
+    auto start = Clock::now();
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        MidiSysExWriter writer;
+        writer.init(sysex);
+        input[0] = uint8_t(i);
+        writer.write(input);
+        writer.finish();
+        checksum += writer.buffer()[7];
+    }
+    std::chrono::duration<double> encode = Clock::now() - start;
+
+    start = Clock::now();
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        MidiSysExParser parser;
+        parser.init(sysex);
+        sysex[6] = uint8_t(i & 0x7F);
+        parser.read(output);
+        checksum += output[5];
+    }
+    std::chrono::duration<double> decode = Clock::now() - start;
+
+    const double megabytes = double(iterations * kPayloadSize) / 1e6;
+    printf("encode: %.1f MB/s\n", megabytes / encode.count());
+    printf("decode: %.1f MB/s\n", megabytes / decode.count());
+    printf("checksum %u\n", checksum);
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include <midi_sysex.h>
+
+#include <cassert>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace tocata;
+
+namespace {
+
+// Bit-at-a-time packing straight from the format definition: the input is a
+// big endian bit stream cut into 7 bit groups, the last one zero padded
+std::vector<uint8_t> referenceEncode(const std::vector<uint8_t>& input, uint8_t channel)
+{
+    std::vector<uint8_t> out = {0xF0, 0x00, 0x2F, 0x7F, channel};
+    uint8_t current = 0;
+    int bits = 0;
+    for (auto b : input)
+    {
+        for (int i = 7; i >= 0; --i)
+        {
+            current = (current << 1) | ((b >> i) & 1);
+            if (++bits == 7)
+            {
+                out.push_back(current);
+                current = 0;
+                bits = 0;
+            }
+        }
+    }
+    if (bits > 0)
+    {
+        out.push_back(current << (7 - bits));
+    }
+    out.push_back(0xF7);
+    return out;
+}
+
+std::vector<uint8_t> encode(const std::vector<uint8_t>& input, uint8_t channel, std::mt19937& rng)
+{
+    std::vector<uint8_t> buffer(MidiSysExWriter::bytesRequired(input.size()));
+    MidiSysExWriter writer;
+    assert(writer.init(buffer, channel));
+    // Random chunking mixes aligned and unaligned entries into the block path
+    size_t offset = 0;
+    while (offset < input.size())
+    {
+        size_t chunk = std::min<size_t>(input.size() - offset, rng() % 24 + 1);
+        assert(writer.write({input.data() + offset, chunk}) == chunk);
+        offset += chunk;
+    }
+    assert(writer.available() == 0 || input.empty());
+    writer.finish();
+    auto res = writer.buffer();
+    return {res.begin(), res.end()};
+}
+
+std::vector<uint8_t> decode(const std::vector<uint8_t>& sysex, uint8_t channel, std::mt19937& rng)
+{
+    MidiSysExParser parser;
+    assert(parser.init(sysex, channel));
+    std::vector<uint8_t> out(parser.available());
+    size_t offset = 0;
+    while (offset < out.size())
+    {
+        size_t chunk = std::min<size_t>(out.size() - offset, rng() % 24 + 1);
+        assert(parser.read({out.data() + offset, chunk}) == chunk);
+        offset += chunk;
+    }
+    uint8_t extra;
+    assert(parser.read({&extra, 1}) == 0);
+    return out;
+}
+
+void testRoundTrip()
+{
+    std::mt19937 rng(1234);
+    for (int iteration = 0; iteration < 20000; ++iteration)
+    {
+        std::vector<uint8_t> input(rng() % 600);
+        for (auto& b : input)
+        {
+            b = uint8_t(rng());
+        }
+        uint8_t channel = rng() % 16;
+
+        auto sysex = encode(input, channel, rng);
+        assert(sysex == referenceEncode(input, channel));
+        assert(decode(sysex, channel, rng) == input);
+    }
+}
+
+void testShortBuffer()
+{
+    // A writer must never accept bytes whose encoding runs into the suffix
+    std::mt19937 rng(42);
+    for (size_t size = kSysExMinSize; size < 64; ++size)
+    {
+        std::vector<uint8_t> input(64, 0xA5);
+        std::vector<uint8_t> buffer(size + 1, 0xEE);
+        MidiSysExWriter writer;
+        assert(writer.init({buffer.data(), size}));
+        size_t expected = writer.available();
+        assert(writer.write(input) == expected);
+        writer.finish();
+        assert(writer.size() <= size);
+        assert(buffer[size] == 0xEE);
+        assert(writer.size() == referenceEncode({input.begin(), input.begin() + expected}, 0).size());
+    }
+}
+
+}
+
+int main()
+{
+    testRoundTrip();
+    testShortBuffer();
+    printf("sysex_test passed\n");
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include <tap_tempo.h>
+
+#include <cassert>
+#include <cstdio>
+
+using namespace tocata;
+
+namespace {
+
+void testAverage()
+{
+    TapTempo tempo;
+    assert(!tempo.tap(1000000));
+    assert(!tempo.available() && tempo.interval() == 0);
+
+    // 120 BPM, with a little jitter either way
+    assert(tempo.tap(1500000 + 300));
+    assert(tempo.tap(2000000 - 300));
+    assert(tempo.tap(2500000));
+    assert(tempo.interval() == 500000);
+    assert(tempo.bpm() == 120);
+
+    // Only the last kMaxIntervals count: four taps at 100 BPM replace it
+    uint32_t now = 2500000;
+    for (size_t i = 0; i < TapTempo::kMaxIntervals; ++i) {
+        now += 600000;
+        assert(tempo.tap(now));
+    }
+    assert(tempo.interval() == 600000);
+    assert(tempo.bpm() == 100);
+}
+
+void testRestart()
+{
+    TapTempo tempo;
+    tempo.tap(0);
+    tempo.tap(500000);
+    assert(tempo.bpm() == 120);
+
+    // A pause longer than the slowest tempo starts over
+    uint32_t now = 500000 + TapTempo::kMaxInterval + 1;
+    assert(!tempo.tap(now));
+    assert(!tempo.available());
+    assert(tempo.tap(now + 400000));
+    assert(tempo.bpm() == 150);
+
+    // A double trigger is ignored and doesn't shorten the next interval
+    now += 400000;
+    assert(!tempo.tap(now + 1000));
+    assert(tempo.tap(now + 400000));
+    assert(tempo.interval() == 400000);
+
+    // Across the micros() wrap
+    tempo.reset();
+    tempo.tap(UINT32_MAX - 100000);
+    assert(tempo.tap(400000 - 100000 - 1));
+    assert(tempo.interval() == 400000);
+}
+
+}
+
+int main()
+{
+    testAverage();
+    testRestart();
+    printf("tap_tempo_test passed\n");
+    return 0;
+}
@@ -1,7 +1,7 @@
 """Python port of the Tocata Pedal API (web/src/api/*.mjs) and its CLI."""
 from importlib.metadata import version as _version
 
-from .api import Api, Command, NUM_PROGRAMS, NUM_SETLISTS
+from .api import Api, Command, NUM_PROGRAMS, NUM_SETLISTS, RecordType, Status
 from .midi_sysex import ANY_CHANNEL, NO_CHANNEL, from_sysex, to_sysex
 from .models import (
     Action,
@@ -18,7 +18,7 @@ from .models import (
     from_wire,
     to_wire,
 )
-from .protocol import Protocol
+from .protocol import Protocol, ResponseError
 from .transport_midi import TransportMidi
 from .uf2 import UF2
 
@@ -27,6 +27,8 @@ __version__ = _version("pytocatapedal")
 __all__ = [
     "Api",
     "Command",
+    "RecordType",
+    "Status",
     "NUM_PROGRAMS",
     "NUM_SETLISTS",
     "ANY_CHANNEL",
@@ -47,6 +49,7 @@ __all__ = [
     "from_wire",
     "to_wire",
     "Protocol",
+    "ResponseError",
     "TransportMidi",
     "UF2",
     "__version__",
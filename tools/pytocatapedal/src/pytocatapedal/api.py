@@ -5,13 +5,15 @@ serializes access to the MIDI link, so unlike the JS Api there's no
 Promise/FIFO request queue to maintain here.
 """
 import logging
+import struct
 from enum import IntEnum
-from typing import List, Optional
+from typing import Iterator, List, Optional
 
-from .models import Backup, Config, FsMode, Mode, Program, Setlist
+from .models import Backup, Config, Diagnostics, FsMode, Mode, Program, Setlist
 from .parsers import (
     parse_addr_payload,
     parse_config,
+    parse_diagnostics,
     parse_names,
     parse_program,
     parse_setlist,
@@ -21,7 +23,7 @@ from .parsers import (
     serialize_program,
     serialize_setlist,
 )
-from .protocol import Protocol
+from .protocol import Protocol, ResponseError
 from .uf2 import UF2
 
 log = logging.getLogger(__name__)
@@ -41,9 +43,33 @@ class Command(IntEnum):
     GET_SETLIST = 0x0B
     SET_SETLIST = 0x0C
     DEL_SETLIST = 0x0D
+    EXPORT = 0x0E
+    IMPORT = 0x0F
     MEM_READ = 0x10
     MEM_WRITE = 0x11
     FLASH_ERASE = 0x12
+    GET_DIAGNOSTICS = 0x13
+
+
+class Status(IntEnum):
+    OK = 0
+    INVALID_COMMAND = 1
+    INVALID_LENGTH = 2
+    INVALID_PROGRAM_ID = 3
+    INVALID_ADDRESS = 4
+    INVALID_PAYLOAD_LENGTH = 5
+    INVALID_SETLIST_ID = 6
+    STORAGE_FULL = 7
+
+
+class RecordType(IntEnum):
+    """ConfigProtocol::RecordType: one item of a bulk EXPORT/IMPORT."""
+
+    BEGIN = 0
+    CONFIG = 1
+    PROGRAM = 2
+    SETLIST = 3
+    END = 4
 
 
 NUM_PROGRAMS = 99
@@ -54,6 +80,18 @@ NUM_SETLISTS = 26
 _CHUNK_SIZE = 500
 
 
+def _expand_scenes(program: Optional[Program]) -> Optional[Program]:
+    # Legacy programs stored as whole-program scene mode force every switch
+    # to scene; expand that into the per-switch model so it round-trips (and
+    # a re-save preserves the scene behavior).
+    if program and program.mode == Mode.SCENE:
+        program.mode = Mode.DEFAULT
+        for fs in program.fs or []:
+            if fs:
+                fs.mode = FsMode.SCENE
+    return program
+
+
 class Api:
     def __init__(self, transport):
         self.connection_event = None
@@ -105,15 +143,7 @@ class Api:
         log.info("getProgram %s", id)
         data = self._send_request(Command.GET_PROGRAM, bytes([id]))
         _pid, program = parse_program(data)
-        # Legacy programs stored as whole-program scene mode force every
-        # switch to scene; expand that into the per-switch model so it
-        # round-trips (and a re-save preserves the scene behavior).
-        if program and program.mode == Mode.SCENE:
-            program.mode = Mode.DEFAULT
-            for fs in program.fs or []:
-                if fs:
-                    fs.mode = FsMode.SCENE
-        return program or Program()
+        return _expand_scenes(program) or Program()
 
     def set_program(self, id: int, program: Program):
         log.info("setProgram %s", id)
@@ -163,13 +193,87 @@ class Api:
         log.info("flashErase %x - %d", address, length)
         self._send_request(Command.FLASH_ERASE, serialize_addr_length(address, length))
 
+    def get_diagnostics(self) -> Diagnostics:
+        log.info("getDiagnostics")
+        data = self._send_request(Command.GET_DIAGNOSTICS)
+        return parse_diagnostics(data) or Diagnostics()
+
     def restart(self):
         self._send_request(Command.RESTART)
 
     def boot_rom(self):
         self._send_request(Command.BOOT_ROM)
 
+    def export(self) -> Backup:
+        """Full backup in a single EXPORT request: the device streams one
+        record per stored item, skipping empty slots."""
+        log.info("export")
+        if not self.connected:
+            raise RuntimeError("Not connected")
+        records = self.protocol.send_stream_request(
+            int(Command.EXPORT), b"", lambda data: data[0] == RecordType.END
+        )
+        config = Config()
+        programs: List[Optional[Program]] = []
+        setlists: List[Optional[Setlist]] = []
+        for record in records:
+            kind, payload = record[0], record[1:]
+            if kind == RecordType.CONFIG:
+                config = parse_config(payload) or Config()
+            elif kind == RecordType.PROGRAM:
+                id, program = parse_program(payload)
+                programs.extend([None] * (id + 1 - len(programs)))
+                programs[id] = _expand_scenes(program)
+            elif kind == RecordType.SETLIST:
+                id, setlist = parse_setlist(payload)
+                setlists.extend([None] * (id + 1 - len(setlists)))
+                setlists[id] = setlist
+        return Backup(
+            version=config.version,
+            midi=config.midi,
+            expression=config.expression,
+            programs=programs,
+            setlists=setlists,
+        )
+
+    def import_(self, backup: Backup):
+        """Full device sync through IMPORT: only stored items are sent, and
+        the END record makes the device delete every slot not included."""
+        self._import_records(backup, self._import_begin())
+
+    def _import_begin(self) -> int:
+        """Opens an import, returning how many records may be in flight."""
+        log.info("import")
+        data = self._send_request(Command.IMPORT, bytes([RecordType.BEGIN]))
+        _applied, window = struct.unpack_from("<HB", data)
+        return window
+
+    def _import_records(self, backup: Backup, window: int):
+        def records() -> Iterator[bytes]:
+            config = Config(version=backup.version, midi=backup.midi, expression=backup.expression)
+            yield bytes([RecordType.CONFIG]) + serialize_config(config)
+            for id, program in enumerate(backup.programs[:NUM_PROGRAMS]):
+                if program and program.name:
+                    yield bytes([RecordType.PROGRAM]) + serialize_program(id, program)
+            for id, setlist in enumerate(backup.setlists[:NUM_SETLISTS]):
+                if setlist and setlist.name:
+                    yield bytes([RecordType.SETLIST]) + serialize_setlist(id, setlist)
+            yield bytes([RecordType.END])
+
+        if not self.connected:
+            raise RuntimeError("Not connected")
+        self.protocol.send_windowed(
+            int(Command.IMPORT), records(), lambda data: struct.unpack_from("<H", data)[0], window
+        )
+
     def backup(self) -> Backup:
+        try:
+            return self.export()
+        except ResponseError as e:
+            # Firmware without EXPORT rejects the request itself
+            if e.status != Status.INVALID_COMMAND:
+                raise
+            log.info("export unsupported, reading items one by one")
         config = self.get_config()
         names = self.get_program_names()
         programs: List[Optional[Program]] = []
@@ -194,6 +298,17 @@ class Api:
         )
 
     def restore(self, backup: Backup):
+        # Only a rejected BEGIN means firmware without IMPORT: anything that
+        # fails once records are going out leaves a half-applied import, and
+        # is not retried item by item
+        try:
+            window = self._import_begin()
+        except ResponseError as e:
+            if e.status != Status.INVALID_COMMAND:
+                raise
+            log.info("import unsupported, writing items one by one")
+        else:
+            return self._import_records(backup, window)
         for id in range(NUM_PROGRAMS):
             program = backup.programs[id] if id < len(backup.programs) else None
             if program and program.name:
@@ -84,6 +84,7 @@ def _build_parser() -> argparse.ArgumentParser:
     p = sub.add_parser("del-setlist")
     p.add_argument("id", type=int)
 
+    sub.add_parser("diagnostics")
     sub.add_parser("restart")
     sub.add_parser("bootrom")
 
@@ -168,6 +169,8 @@ def _dispatch(api: Api, args: argparse.Namespace):
         api.set_setlist(args.id, from_wire(Setlist, _read_json(args.path)))
     elif command == "del-setlist":
         api.delete_setlist(args.id)
+    elif command == "diagnostics":
+        print(json.dumps(to_wire(api.get_diagnostics()), indent=2))
     elif command == "restart":
         api.restart()
         print("restarting")
@@ -40,6 +40,7 @@ class FsMode(str, Enum):
     MOMENTARY = "momentary"
     SCENE = "scene"
     PROGRAM = "program"
+    TAP = "tap"
 
 
 @dataclass
@@ -90,6 +91,8 @@ class Program:
     actions: List[Action] = field(default_factory=list)
     mode: Mode = Mode.DEFAULT
     # Same global-channel flag as Action.global_channel, for the expression pedal.
+    # 14-bit CC pair on expression and expression + 32; only for CCs below 32.
+    exp_high_res: int = field(default=0, metadata={"wire": "expHighRes"})
     exp_global_channel: int = field(default=0, metadata={"wire": "expGlobalChannel"})
     exp_channel: int = field(default=0, metadata={"wire": "expChannel"})
     expression: int = 0
@@ -101,6 +104,26 @@ class Setlist:
     programs: List[int] = field(default_factory=list)
 
 
+@dataclass
+class Diagnostics:
+    """ConfigProtocol::Diagnostics -- counters and maxima cover the time since the previous request."""
+
+    uptime_ms: int = field(default=0, metadata={"wire": "uptimeMs"})
+    frame_budget_us: int = field(default=0, metadata={"wire": "frameBudgetUs"})
+    frame_last_us: int = field(default=0, metadata={"wire": "frameLastUs"})
+    frame_max_us: int = field(default=0, metadata={"wire": "frameMaxUs"})
+    frame_avg_us: int = field(default=0, metadata={"wire": "frameAvgUs"})
+    frames_rendered: int = field(default=0, metadata={"wire": "framesRendered"})
+    frames_skipped: int = field(default=0, metadata={"wire": "framesSkipped"})
+    # Animation frames drawn: 1 in frame_divider
+    frame_divider: int = field(default=1, metadata={"wire": "frameDivider"})
+    # Worst MIDI clock tick, after its due time
+    clock_late_max_us: int = field(default=0, metadata={"wire": "clockLateMaxUs"})
+    clock_ticks: int = field(default=0, metadata={"wire": "clockTicks"})
+    # Ticks the clock alarm left to the main loop
+    clock_deferred: int = field(default=0, metadata={"wire": "clockDeferred"})
+
+
 @dataclass
 class Backup:
     """Config plus every stored program/setlist -- the shape of a backup JSON file."""
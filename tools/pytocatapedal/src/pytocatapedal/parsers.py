@@ -11,7 +11,7 @@ import logging
 import struct as _struct
 from typing import Optional, Tuple
 
-from .models import Config, Program, Setlist, from_wire, to_wire
+from .models import Config, Diagnostics, Program, Setlist, from_wire, to_wire
 
 log = logging.getLogger(__name__)
 
@@ -25,7 +25,7 @@ MAX_PROGRAMS = 99  # Program::kMaxPrograms
 MESSAGE_TYPES = [None, "PC", "CC", "NO", "NF"]
 COLORS = [None, "blue", "purple", "red", "yellow", "green", "turquoise"]
 MODES = ["default", "scene"]
-FS_MODES = ["stomp", "momentary", "scene", "program"]
+FS_MODES = ["stomp", "momentary", "scene", "program", "tap"]
 
 
 def _is_empty(value):
@@ -299,9 +299,10 @@ NAMES_SCHEME = {
 }
 
 # Same low-nibble split as TYPE_AND_CHANNEL_SCHEME, for the expression pedal channel.
+# Bit 2 sends the pedal as a 14-bit CC pair (CC n MSB + CC n+32 LSB).
 MODE_AND_CHANNEL_SCHEME = {
     "parser": ("uint8",),
-    "fields": [(3, "enum", MODES), (1, "uint8"), (4, "uint8")],
+    "fields": [(2, "enum", MODES), (1, "uint8"), (1, "uint8"), (4, "uint8")],
 }
 
 PROGRAM_SCHEME = {
@@ -309,7 +310,7 @@ PROGRAM_SCHEME = {
         ("name", "str", MAX_PRG_NAME_SIZE),
         ("fs", "nArray", MAX_SWITCHES, "struct", FOOTSWITCH_SCHEME),
         ("actions", "nArray", MAX_ACTIONS, "struct", ACTION_SCHEME),
-        (("mode", "expGlobalChannel", "expChannel"), "compact", MODE_AND_CHANNEL_SCHEME),
+        (("mode", "expHighRes", "expGlobalChannel", "expChannel"), "compact", MODE_AND_CHANNEL_SCHEME),
         ("expression", "uint8"),
     ],
     "valid": lambda o: bool(o.get("name")),
@@ -330,6 +331,22 @@ ID_PLUS_SETLIST_SCHEME = {"fields": [("id", "uint8"), ("setlist", "struct", SETL
 ADDRESS_AND_LENGTH_SCHEME = {"fields": [("address", "uint32"), ("length", "uint32")]}
 ADDRESS_AND_PAYLOAD_SCHEME = {"fields": [("address", "uint32"), ("payload", "u32Buffer")]}
 
+DIAGNOSTICS_SCHEME = {
+    "fields": [
+        ("uptimeMs", "uint32"),
+        ("frameBudgetUs", "uint32"),
+        ("frameLastUs", "uint32"),
+        ("frameMaxUs", "uint32"),
+        ("frameAvgUs", "uint32"),
+        ("framesRendered", "uint16"),
+        ("framesSkipped", "uint16"),
+        ("frameDivider", "uint8"),
+        ("clockLateMaxUs", "uint32"),
+        ("clockTicks", "uint16"),
+        ("clockDeferred", "uint16"),
+    ]
+}
+
 
 def _parse_buffer(buffer: bytes, scheme) -> Tuple[Optional[dict], int]:
     return PARSERS["struct"](buffer, 0, scheme)
@@ -389,6 +406,11 @@ def parse_addr_payload(buffer: bytes) -> Tuple[int, bytes]:
     return wire["address"], bytes(wire.get("payload") or b"")
 
 
+def parse_diagnostics(buffer: bytes) -> Optional[Diagnostics]:
+    wire, _ = _parse_buffer(buffer, DIAGNOSTICS_SCHEME)
+    return from_wire(Diagnostics, wire) if wire is not None else None
+
+
 def serialize_addr_payload(address: int, payload: bytes) -> bytes:
     return _serialize_buffer({"address": address, "payload": bytes(payload)}, ADDRESS_AND_PAYLOAD_SCHEME)
 
@@ -8,7 +8,7 @@ send+receive is enough since callers issue one request at a time.
 """
 import struct as _struct
 import threading
-from typing import Tuple
+from typing import Callable, Iterable, List, Tuple
 
 LENGTH_OFFSET = 0
 COMMAND_OFFSET = 2
@@ -16,6 +16,14 @@ STATUS_OFFSET = 3
 MSG_HEADER_SIZE = 4
 
 
+class ResponseError(RuntimeError):
+    """The device answered a request with a non-zero status."""
+
+    def __init__(self, status: int):
+        super().__init__(f"Response with status {status}")
+        self.status = status
+
+
 class Protocol:
     def __init__(self, transport, connection_event=None):
         self.transport = transport
@@ -44,18 +52,62 @@ class Protocol:
 
         command = self._buffer[COMMAND_OFFSET]
         status = self._buffer[STATUS_OFFSET]
-        # Mirrors the JS side: this is every trailing buffered byte, not just
-        # `length` of them -- harmless, since struct parsing only consumes as
-        # many bytes as its scheme declares.
-        data = bytes(self._buffer[MSG_HEADER_SIZE:])
+        # Only `length` bytes: a streamed EXPORT may already have buffered the
+        # start of the next response behind this one.
+        data = bytes(self._buffer[MSG_HEADER_SIZE:total_length])
         self._buffer = self._buffer[total_length:] if len(self._buffer) > total_length else bytearray()
 
         if status != 0:
-            raise RuntimeError(f"Response with status {status}")
+            raise ResponseError(status)
         return command, data
 
+    def _send(self, command: int, data: bytes):
+        header = _struct.pack("<HBB", len(data), command, 0)
+        self.transport.send(header + bytes(data))
+
     def send_request(self, command: int, data: bytes = b"") -> Tuple[int, bytes]:
         with self._lock:
-            header = _struct.pack("<HBB", len(data), command, 0)
-            self.transport.send(header + bytes(data))
+            self._send(command, data)
             return self._receive()
+
+    def send_stream_request(
+        self, command: int, data: bytes, is_last: Callable[[bytes], bool]
+    ) -> List[bytes]:
+        """Sends a request the device answers with a stream of responses,
+        collecting their payloads up to and including the one `is_last`
+        accepts. The device paces the stream itself, so there is nothing to
+        acknowledge in between. Only the first response can reject the
+        request: a bad status after it is reported as a broken stream."""
+        with self._lock:
+            self._send(command, data)
+            _command, response = self._receive()
+            responses = [response]
+            while not is_last(response):
+                try:
+                    _command, response = self._receive()
+                except ResponseError as e:
+                    raise RuntimeError(f"Stream broken after {len(responses)} responses: {e}") from e
+                responses.append(response)
+            return responses
+
+    def send_windowed(
+        self, command: int, payloads: Iterable[bytes], acked: Callable[[bytes], int], window: int
+    ) -> bytes:
+        """Sends one message per payload without waiting for each answer. The
+        device acknowledges every few with a payload `acked` turns into how
+        many it has applied so far, and no more than `window` are left
+        unacknowledged. Returns the payload of the last acknowledgment."""
+        with self._lock:
+            sent = 0
+            applied = 0
+            last = b""
+            for payload in payloads:
+                while sent - applied >= window:
+                    _command, last = self._receive()
+                    applied = acked(last)
+                self._send(command, payload)
+                sent += 1
+            while applied < sent:
+                _command, last = self._receive()
+                applied = acked(last)
+            return last
@@ -0,0 +1,173 @@
+import struct
+
+import pytest
+
+from pytocatapedal.api import Api, Command, RecordType, Status
+from pytocatapedal.models import Backup, Config, Midi, Program, Setlist
+from pytocatapedal.parsers import (
+    serialize_config,
+    serialize_program,
+    serialize_setlist,
+)
+from pytocatapedal.protocol import ResponseError
+
+WINDOW = 8
+ACK_EVERY = WINDOW // 2
+
+
+def _message(command, payload=b"", status=0):
+    return struct.pack("<HBB", len(payload), command, status) + payload
+
+
+class FakeDevice:
+    """Answers EXPORT/IMPORT the way ConfigProtocol does, handing out every
+    queued response in a single receive() to exercise response splitting."""
+
+    def __init__(self, config, programs, setlists, export=True, import_=True, export_status=0, reject=None):
+        self.connected = True
+        self.config = config
+        self.programs = dict(programs)
+        self.setlists = dict(setlists)
+        self.export = export
+        self.import_ = import_
+        self.export_status = export_status
+        # Record type the device refuses with INVALID_PROGRAM_ID
+        self.reject = reject
+        self.imported = []
+        self.commands = []
+        self.acks = 0
+        # Records sent without the host reading in between
+        self.in_flight = 0
+        self.max_in_flight = 0
+        self._applied = 0
+        self._state = "idle"
+        self._out = b""
+
+    def send(self, data):
+        length, command, _status = struct.unpack_from("<HBB", data)
+        payload = bytes(data[4 : 4 + length])
+        self.commands.append(command)
+        if command != Command.IMPORT:
+            self._state = "idle"
+        if command == Command.EXPORT and self.export:
+            if self.export_status:
+                self._out += _message(command, status=self.export_status)
+                return
+            records = [bytes([RecordType.CONFIG]) + serialize_config(self.config)]
+            records += [bytes([RecordType.PROGRAM]) + serialize_program(id, p) for id, p in sorted(self.programs.items())]
+            records += [bytes([RecordType.SETLIST]) + serialize_setlist(id, s) for id, s in sorted(self.setlists.items())]
+            records.append(bytes([RecordType.END]))
+            self._out += b"".join(_message(command, record) for record in records)
+        elif command == Command.IMPORT and self.import_:
+            self._import(command, payload[0])
+        elif command in (
+            Command.SET_CONFIG,
+            Command.SET_PROGRAM,
+            Command.DEL_PROGRAM,
+            Command.SET_SETLIST,
+            Command.DEL_SETLIST,
+        ):
+            self._out += _message(command)
+        else:
+            self._out += _message(command, status=Status.INVALID_COMMAND)
+
+    def _import(self, command, kind):
+        def ack():
+            self.acks += 1
+            self._out += _message(command, struct.pack("<HB", self._applied, WINDOW))
+
+        if kind == RecordType.BEGIN:
+            self._applied = 0
+            self._state = "active"
+            ack()
+            return
+        if self._state == "rejected":
+            return
+        self.imported.append(kind)
+        self.in_flight += 1
+        self.max_in_flight = max(self.max_in_flight, self.in_flight)
+        if kind == self.reject:
+            self._state = "rejected"
+            self._out += _message(command, status=Status.INVALID_PROGRAM_ID)
+            return
+        self._applied += 1
+        if kind == RecordType.END or self._applied % ACK_EVERY == 0:
+            ack()
+
+    def receive(self):
+        self.in_flight = 0
+        out, self._out = self._out, b""
+        return out
+
+
+def _items():
+    programs = {0: Program(name="First"), 5: Program(name="Sixth")}
+    setlists = {2: Setlist(name="Gig", programs=[5, 0])}
+    return programs, setlists
+
+
+def test_export_places_records_by_id():
+    programs, setlists = _items()
+    device = FakeDevice(Config(version=2, midi=Midi(channel=3)), programs, setlists)
+    backup = Api(device).backup()
+    assert backup.midi.channel == 3
+    assert [p.name if p else None for p in backup.programs] == ["First", None, None, None, None, "Sixth"]
+    assert backup.setlists[2].name == "Gig"
+    assert backup.setlists[2].programs == [5, 0]
+
+
+def test_import_sends_stored_items_between_begin_and_end():
+    programs, setlists = _items()
+    device = FakeDevice(Config(), {}, {})
+    backup = Backup(
+        programs=[programs[0], None, Program(name="")] + [None] * 2 + [programs[5]],
+        setlists=[None, None, setlists[2]],
+    )
+    Api(device).restore(backup)
+    assert device.imported == [
+        RecordType.CONFIG,
+        RecordType.PROGRAM,
+        RecordType.PROGRAM,
+        RecordType.SETLIST,
+        RecordType.END,
+    ]
+    assert device.commands == [Command.IMPORT] * 6
+
+
+def test_import_streams_records_within_the_window():
+    device = FakeDevice(Config(), {}, {})
+    backup = Backup(programs=[Program(name=f"P{id}") for id in range(40)])
+    Api(device).restore(backup)
+    # Config, 40 programs and the end record
+    assert len(device.imported) == 42
+    assert device.max_in_flight <= WINDOW
+    # Begin, every ACK_EVERY records, and the end record
+    assert device.acks == 1 + 42 // ACK_EVERY + 1
+
+
+def test_restore_falls_back_when_begin_is_rejected():
+    programs, setlists = _items()
+    device = FakeDevice(Config(), {}, {}, import_=False)
+    Api(device).restore(Backup(programs=[programs[0]], setlists=[None, None, setlists[2]]))
+    assert device.commands.count(Command.IMPORT) == 1
+    assert device.commands.count(Command.SET_PROGRAM) == 1
+    assert device.commands.count(Command.DEL_PROGRAM) == 98
+    assert device.commands.count(Command.SET_SETLIST) == 1
+    assert device.commands[-1] == Command.SET_CONFIG
+
+
+def test_restore_reraises_a_failure_after_begin():
+    programs, _setlists = _items()
+    device = FakeDevice(Config(), {}, {}, reject=RecordType.PROGRAM)
+    with pytest.raises(ResponseError) as error:
+        Api(device).restore(Backup(programs=[programs[0], programs[5]]))
+    assert error.value.status == Status.INVALID_PROGRAM_ID
+    # No item-by-item restore on top of the half-applied import
+    assert set(device.commands) == {Command.IMPORT}
+
+
+def test_backup_reraises_errors_other_than_unsupported():
+    device = FakeDevice(Config(), {}, {}, export_status=Status.INVALID_LENGTH)
+    with pytest.raises(ResponseError):
+        Api(device).backup()
+    assert device.commands == [Command.EXPORT]
@@ -1,7 +1,10 @@
+import struct
+
 from pytocatapedal.models import (
     Action,
     Color,
     Config,
+    Diagnostics,
     ExpressionCal,
     Footswitch,
     FsMode,
@@ -18,6 +21,7 @@ from pytocatapedal.parsers import (
     _serialize_buffer,
     parse_addr_payload,
     parse_config,
+    parse_diagnostics,
     parse_names,
     parse_program,
     parse_setlist,
@@ -98,6 +102,25 @@ def test_addr_payload_round_trip():
     assert payload == b"\x01\x02\x03"
 
 
+def test_diagnostics_layout():
+    # ConfigProtocol::Diagnostics: five uint32, two uint16, a uint8, then the
+    # clock's uint32 and two uint16, packed
+    data = struct.pack("<IIIIIHHBIHH", 123456, 8333, 4100, 9000, 4200, 25, 5, 2, 37, 480, 3)
+    assert parse_diagnostics(data) == Diagnostics(
+        uptime_ms=123456,
+        frame_budget_us=8333,
+        frame_last_us=4100,
+        frame_max_us=9000,
+        frame_avg_us=4200,
+        frames_rendered=25,
+        frames_skipped=5,
+        frame_divider=2,
+        clock_late_max_us=37,
+        clock_ticks=480,
+        clock_deferred=3,
+    )
+
+
 def test_type_and_channel_compact_packing():
     # type=CC (index 2, bits 0-2), globalChannel=0 (bit 3), channel=5 (bits 4-7)
     # -> byte 0x52. globalChannel=0 happens to leave this identical to the old
@@ -141,6 +164,17 @@ def test_mode_and_channel_compact_packing_global():
     assert data[offset] == 0x08 | (9 << 4)
 
 
+def test_mode_and_channel_compact_packing_high_res():
+    # mode=scene (index 1), expHighRes=1 (bit 2), expChannel=3 -> byte 0x35
+    program = Program(name="X", mode=Mode.SCENE, exp_high_res=1, exp_channel=3, expression=11)
+    data = serialize_program(0, program)
+    offset = 1 + 31 + 353 + 16
+    assert data[offset] == 0x01 | 0x04 | (3 << 4)
+    _, parsed = parse_program(data)
+    assert parsed.exp_high_res == 1
+    assert parsed.mode == Mode.SCENE
+
+
 def test_enum_unmatched_value_wraps_to_255():
     # A footswitch mode with no matching entry in FS_MODES serializes as 0xFF
     # (JS's Uint8Array wraparound for findIndex()==-1) -- relied on elsewhere
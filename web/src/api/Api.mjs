@@ -11,6 +11,7 @@ import {
   parseAddrPayload,
   serializeAddrPayload,
   serializeAddrLength,
+  parseDiagnostics,
 } from "./Parsers.mjs";
 
 const RESTART = 1;
@@ -26,9 +27,22 @@ const GET_SETLISTS = 0x0A;
 const GET_SETLIST = 0x0B;
 const SET_SETLIST = 0x0C;
 const DEL_SETLIST = 0x0D;
+const EXPORT = 0x0E;
+const IMPORT = 0x0F;
 const MEM_READ = 0x10;
 const MEM_WRITE = 0x11;
 const FLASH_ERASE = 0x12;
+const GET_DIAGNOSTICS = 0x13;
+
+// ConfigProtocol::Status
+const STATUS_INVALID_COMMAND = 1;
+
+// ConfigProtocol::RecordType, first byte of every EXPORT/IMPORT payload
+const RECORD_BEGIN = 0;
+const RECORD_CONFIG = 1;
+const RECORD_PROGRAM = 2;
+const RECORD_SETLIST = 3;
+const RECORD_END = 4;
 
 const NUM_PROGRAMS = 99;
 // Setlist 0 on the pedal is the built-in "All" setlist and is not stored, so
@@ -40,6 +54,17 @@ const NUM_SETLISTS = 26;
 // field, and serializing it as absent would write a degenerate 0..0 range.
 const DEFAULT_EXP_CAL = { minRaw: 0, maxRaw: 4095 };
 
+// Legacy programs stored as scene mode force every switch to scene; expand
+// that into the per-switch model so the UI shows them correctly and a re-save
+// preserves the scene behavior.
+function expandScenes(program) {
+  if (program && program.mode === 'scene') {
+    program.mode = 'default';
+    (program.fs || []).forEach(fs => { if (fs) fs.mode = 'scene'; });
+  }
+  return program;
+}
+
 export default class Api {
   constructor(transport) {
     this.protocol = null;
@@ -54,11 +79,24 @@ export default class Api {
   version = _ => this.protocol.version();
   connect = reconnect => this.protocol.connect(reconnect);
 
-  sendRequest(command, buffer) {
+  sendRequest(command, buffer, isLast) {
+    const data = new Uint8Array(buffer);
+    return this.enqueue(async () => {
+      if (isLast) {
+        const responses = await this.protocol.sendStreamRequest(command, data, isLast);
+        return responses.map(({data}) => data.buffer);
+      }
+      const {data: res} = await this.protocol.sendRequest(command, data);
+      return res.buffer;
+    });
+  }
+
+  // Runs one exchange with the device at a time, in call order
+  enqueue(exchange) {
     if (!this.connected) {
       throw new Error('Not connected');
     }
-    const request = {command, data: new Uint8Array(buffer)};
+    const request = {exchange};
     const promise = new Promise((resolve, reject) => {
       request.resolve = resolve;
       request.reject = reject;
@@ -71,8 +109,7 @@ export default class Api {
       }
       const req = this.requestQueue[0];
       try {
-        const {data} = await this.protocol.sendRequest(req.command, req.data);
-        req.resolve(data.buffer);  
+        req.resolve(await req.exchange());
       } catch(e) {
         req.reject(e);
       }
@@ -122,14 +159,7 @@ export default class Api {
     console.log('getprogram', id);
     const data = await this.sendRequest(GET_PROGRAM, new Uint8Array([id]));
     const {program} = parseProgram(data);
-    // Legacy programs stored as scene mode force every switch to scene; expand
-    // that into the per-switch model so the UI shows them correctly and a
-    // re-save preserves the scene behavior.
-    if (program && program.mode === 'scene') {
-      program.mode = 'default';
-      (program.fs || []).forEach(fs => { if (fs) fs.mode = 'scene'; });
-    }
-    return program || {};
+    return expandScenes(program) || {};
   }
 
   async setProgram(id, program) {
@@ -194,6 +224,12 @@ export default class Api {
     await this.sendRequest(FLASH_ERASE, data);
   }
 
+  async getDiagnostics() {
+    console.log('getDiagnostics');
+    const res = await this.sendRequest(GET_DIAGNOSTICS);
+    return parseDiagnostics(res);
+  }
+
   async restart() {
     await this.sendRequest(RESTART);
   }
@@ -202,7 +238,92 @@ export default class Api {
     await this.sendRequest(BOOT_ROM);
   }
 
+  // Whole backup in one EXPORT request; the device streams a record per stored
+  // item and paces itself, so there is no per-item round trip.
+  async exportAll() {
+    console.log('exportAll');
+    const records = await this.sendRequest(EXPORT, new Uint8Array(), data => data[0] === RECORD_END);
+    let res = {};
+    const programs = [];
+    const setlists = [];
+    for (const record of records) {
+      const payload = record.slice(1);
+      switch (new Uint8Array(record)[0]) {
+        case RECORD_CONFIG:
+          res = parseConfig(payload);
+          break;
+        case RECORD_PROGRAM: {
+          const {id, program} = parseProgram(payload);
+          programs[id] = expandScenes(program);
+          break;
+        }
+        case RECORD_SETLIST: {
+          const {id, setlist} = parseSetlist(payload);
+          setlists[id] = setlist;
+          break;
+        }
+        default:
+          break;
+      }
+    }
+    return {...res, programs, setlists};
+  }
+
+  // Full device sync through IMPORT: only stored items travel, and the end
+  // record makes the device delete every slot the import didn't include.
+  async importAll(backup) {
+    await this.importRecords(backup, await this.importBegin());
+  }
+
+  // Opens an import, resolving to how many records may be in flight
+  async importBegin() {
+    console.log('importAll');
+    const res = await this.sendRequest(IMPORT, new Uint8Array([RECORD_BEGIN]));
+    return new DataView(res).getUint8(2);
+  }
+
+  // Records stream without a round trip each; the device acknowledges every
+  // few with the number it has applied
+  importRecords(backup, window) {
+    const record = (type, payload = new Uint8Array()) => {
+      const data = new Uint8Array(1 + payload.byteLength);
+      data[0] = type;
+      data.set(new Uint8Array(payload), 1);
+      return data;
+    };
+    const records = [record(RECORD_CONFIG, serializeConfig({
+      ...backup,
+      expression: { ...DEFAULT_EXP_CAL, ...(backup.expression || {}) },
+    }))];
+    const programs = backup.programs || [];
+    for (let id = 0; id < NUM_PROGRAMS; ++id) {
+      const program = programs[id];
+      if (program && program.name) {
+        records.push(record(RECORD_PROGRAM, serializeProgram({id, program})));
+      }
+    }
+    const setlists = backup.setlists || [];
+    for (let id = 0; id < NUM_SETLISTS; ++id) {
+      const setlist = setlists[id];
+      if (setlist && setlist.name) {
+        records.push(record(RECORD_SETLIST, serializeSetlist({id, setlist})));
+      }
+    }
+    records.push(record(RECORD_END));
+    const acked = data => new DataView(data.buffer, data.byteOffset).getUint16(0, true);
+    return this.enqueue(() => this.protocol.sendWindowed(IMPORT, records, acked, window));
+  }
+
   async backup() {
+    try {
+      return await this.exportAll();
+    } catch (e) {
+      // Firmware without EXPORT rejects the request itself
+      if (e.status !== STATUS_INVALID_COMMAND) {
+        throw e;
+      }
+      console.log('exportAll unsupported, reading items one by one');
+    }
     const res = await this.getConfig();
     const names = await this.getProgramNames();
     res.programs = [];
@@ -222,6 +343,21 @@ export default class Api {
   }
 
   async restore(backup) {
+    // Only a rejected begin means firmware without IMPORT: anything that fails
+    // once records are going out leaves a half-applied import, and is not
+    // retried item by item
+    let window;
+    try {
+      window = await this.importBegin();
+    } catch (e) {
+      if (e.status !== STATUS_INVALID_COMMAND) {
+        throw e;
+      }
+      console.log('importAll unsupported, writing items one by one');
+    }
+    if (window !== undefined) {
+      return await this.importRecords(backup, window);
+    }
     const programs = backup.programs;
     for (let id = 0; id < NUM_PROGRAMS; ++id) {
       const program = programs[id];
@@ -169,6 +169,7 @@ const fsMode = [
   'momentary',
   'scene',
   'program',
+  'tap',
 ];
 
 const midi = {
@@ -240,10 +241,12 @@ const names = {
 };
 
 // Same low-nibble split as typeAndChannel, for the expression pedal channel.
+// Bit 2 sends the pedal as a 14-bit CC pair (CC n MSB + CC n+32 LSB).
 const modeAndChannel = {
   parser: ['uint8'],
   fields: [
-    [3, 'enum', mode],
+    [2, 'enum', mode],
+    [1, 'uint8'],
     [1, 'uint8'],
     [4, 'uint8'],
   ],
@@ -254,7 +257,7 @@ const program = {
     ['name', 'str', MAX_PRG_NAME_SIZE],
     ['fs', 'nArray', MAX_SWITCHES, 'struct', footswitch],
     ['actions', 'nArray', MAX_ACTIONS, 'struct', action],
-    [['mode', 'expGlobalChannel', 'expChannel'], 'compact', modeAndChannel],
+    [['mode', 'expHighRes', 'expGlobalChannel', 'expChannel'], 'compact', modeAndChannel],
     ['expression', 'uint8'],
   ],
   valid: o => o.name
@@ -296,6 +299,23 @@ const addressAndPayload = {
   ]
 };
 
+// ConfigProtocol::Diagnostics; counters and maxima since the previous request
+const diagnostics = {
+  fields: [
+    ['uptimeMs', 'uint32'],
+    ['frameBudgetUs', 'uint32'],
+    ['frameLastUs', 'uint32'],
+    ['frameMaxUs', 'uint32'],
+    ['frameAvgUs', 'uint32'],
+    ['framesRendered', 'uint16'],
+    ['framesSkipped', 'uint16'],
+    ['frameDivider', 'uint8'],
+    ['clockLateMaxUs', 'uint32'],
+    ['clockTicks', 'uint16'],
+    ['clockDeferred', 'uint16'],
+  ]
+};
+
 const parseStruct = (buffer, parser) => parsers.struct(new DataView(buffer), 0, parser)[0];
 const serializeStruct = (buffer, value, parser) => buffer.slice(0, serializers.struct(new DataView(buffer), 0, value, parser));
 
@@ -304,6 +324,7 @@ export const parseNames = buffer => parseStruct(buffer, names);
 export const parseProgram = buffer => parseStruct(buffer, idPlusProgram);
 export const parseSetlist = buffer => parseStruct(buffer, idPlusSetlist);
 export const parseAddrPayload = buffer => parseStruct(buffer, addressAndPayload);
+export const parseDiagnostics = buffer => parseStruct(buffer, diagnostics);
 export const serializeConfig = value => serializeStruct(new Uint8Array(512).buffer, value, config);
 export const serializeProgram = value => serializeStruct(new Uint8Array(512).buffer, value, idPlusProgram);
 export const serializeSetlist = value => serializeStruct(new Uint8Array(512).buffer, value, idPlusSetlist);
@@ -41,18 +41,22 @@ export default class Protocol {
 
     const command = msg.getUint8(COMMAND_OFFSET);
     const status = msg.getUint8(STATUS_OFFSET);
-    const data = this.buffer.slice(MSG_HEADER_SIZE);
+    // Only this message's bytes: a streamed export may already have buffered
+    // the start of the next response behind it.
+    const data = this.buffer.slice(MSG_HEADER_SIZE, totalLength);
     this.buffer = (this.buffer.byteLength > totalLength) ? this.buffer.slice(totalLength) : new Uint8Array();
 
     if (status === 0) {
       // console.log('receive', {command, status, data});
       return {command, status, data};
     } else {
-      throw new Error(`Response with status ${status}`);
+      const error = new Error(`Response with status ${status}`);
+      error.status = status;
+      throw error;
     }
   }
 
-  async sendRequest(command, data = new Uint8Array()) {
+  async send(command, data = new Uint8Array()) {
     const outBuffer = new Uint8Array(MSG_HEADER_SIZE + data.byteLength);
     const msg = new DataView(outBuffer.buffer);
     msg.setUint16(LENGTH_OFFSET, data.byteLength, true);
@@ -60,6 +64,49 @@ export default class Protocol {
     msg.setUint8(STATUS_OFFSET, 0);
     outBuffer.set(data, MSG_HEADER_SIZE);
     await this.transport.send(msg);
+  }
+
+  async sendRequest(command, data = new Uint8Array()) {
+    await this.send(command, data);
     return await this.receive();
   }
+
+  // For requests the device answers with a stream of responses, collected up
+  // to and including the one isLast accepts. Only the first response can
+  // reject the request: a bad status after it is reported as a broken stream.
+  async sendStreamRequest(command, data, isLast) {
+    const responses = [await this.sendRequest(command, data)];
+    while (!isLast(responses[responses.length - 1].data)) {
+      try {
+        responses.push(await this.receive());
+      } catch (e) {
+        throw new Error(`Stream broken after ${responses.length} responses: ${e.message}`);
+      }
+    }
+    return responses;
+  }
+
+  // Sends one message per payload without waiting for each answer. The device
+  // acknowledges every few with a payload acked turns into how many it has
+  // applied so far, and no more than window are left unacknowledged.
+  async sendWindowed(command, payloads, acked, window) {
+    let sent = 0;
+    let applied = 0;
+    let last;
+    const waitAck = async () => {
+      last = await this.receive();
+      applied = acked(last.data);
+    };
+    for (const payload of payloads) {
+      while (sent - applied >= window) {
+        await waitAck();
+      }
+      await this.send(command, payload);
+      ++sent;
+    }
+    while (applied < sent) {
+      await waitAck();
+    }
+    return last;
+  }
 }
\ No newline at end of file
@@ -127,6 +127,12 @@ async function main() {
         await api.deleteSetlist(id);
         break;
       }
+      case 'diagnostics':
+      {
+        const diagnostics = await api.getDiagnostics();
+        console.log(JSON.stringify(diagnostics, null, 2));
+        break;
+      }
       case 'restart':
       {
         await api.restart();
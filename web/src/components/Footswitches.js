@@ -24,6 +24,7 @@ const fsModes = [
   { value: 'momentary', name: 'Momentary' },
   { value: 'scene', name: 'Scene' },
   { value: 'program', name: 'Program' },
+  { value: 'tap', name: 'Tap tempo' },
 ]
 const MAX_NAME_LENGTH = 5;
 
@@ -84,6 +84,7 @@ function ProgramDialog(props) {
     expression: invalidCC(DEFAULT_EXP_CC),
     expChannel: 0,
     expGlobalChannel: 0,
+    expHighRes: 0,
     actions: [],
     fs: [],
   }), [])
@@ -100,6 +101,10 @@ function ProgramDialog(props) {
   // Keeps the explicit channel underneath, so unticking restores it.
   const updateGlobalChannel = event =>
     setState(state => ({ ...state, expGlobalChannel: event.target.checked ? 1 : 0 }));
+  // The LSB goes out on CC + 32, so only the MSB controllers 0-31 qualify.
+  const canHighRes = isValidCC(state.expression) && state.expression < 32;
+  const updateHighRes = event =>
+    setState(state => ({ ...state, expHighRes: event.target.checked ? 1 : 0 }));
 
   function update() {
     setProgram(id, state);
@@ -145,6 +150,17 @@ function ProgramDialog(props) {
                 name="expression"
                 onChange={updateSwitch}
             />          
+            <FormControlLabel
+                className={classes.switch}
+                label="14-bit"
+                control={
+                  <Switch
+                    checked={canHighRes && !!state.expHighRes}
+                    disabled={!canHighRes}
+                    onChange={updateHighRes}
+                  />
+                }
+            />
           </div>
           <div>
             <TextField